@@ -25,22 +25,113 @@
 
 #include <adc.h>
 #include <stm8s.h>
+#include <pwm.h>
 
-uint16_t ADC_read(uint8_t channel)
+static volatile uint16_t _samples[ADC_NUM_CHANNELS];
+static volatile uint8_t _scanComplete = 0;
+static volatile uint8_t _fault = 0;
+static uint8_t _watchdogChannel = 0;
+static uint16_t _watchdogLow = 0;
+
+void ADC1_interrupt_handler() __interrupt(ADC1_ISR)
+{
+    // Data buffer registers are consecutive DBxRH/DBxRL pairs
+    volatile uint8_t *dbr = &ADC1_DB0RH;
+    for (uint8_t ch = 0; ch < ADC_NUM_CHANNELS; ch++, dbr += 2)
+    {
+        // right-aligned data: LSB must be read first
+        uint8_t adcL = dbr[1];
+        uint8_t adcH = dbr[0];
+        _samples[ch] = adcL | (adcH << 8);
+    }
+    // The analog watchdog shares the interrupt, cut the heater before anything else
+    if (ADC1_CSR & (1 << ADC1_CSR_AWD))
+    {
+        PWM_forceOff(PWM_CH1);
+        _fault = (_samples[_watchdogChannel] < _watchdogLow) ? ADC_FAULT_LOW : ADC_FAULT_HIGH;
+        ADC1_AWSRL = 0;
+    }
+    ADC1_CSR &= ~((1 << ADC1_CSR_EOC) | (1 << ADC1_CSR_AWD)); // clear EOC and AWD flags
+    _scanComplete = 1;
+}
+
+void TIM2_CC_interrupt_handler() __interrupt(TIM2_CC_ISR)
+{
+    TIM2_SR1 &= ~(1 << TIM2_SR1_CC2IF);
+    ADC_startScan();
+}
+
+void ADC_init()
 {
-    /* Configure ADC channel */
-    ADC1_CSR = channel;
-    /* Right-align data */
-    ADC1_CR2 |= (1 << ADC1_CR2_ALIGN);
+    /* Right-align data, scan mode */
+    ADC1_CR2 = (1 << ADC1_CR2_ALIGN) | (1 << ADC1_CR2_SCAN);
+    /* Store every channel in its own data buffer register */
+    ADC1_CR3 = (1 << ADC1_CR3_DBUF);
+    /* Last channel of the scan, interrupt at the end of conversion, keep the watchdog */
+    ADC1_CSR = (ADC1_CSR & (1 << ADC1_CSR_AWDIE)) | (1 << ADC1_CSR_EOCIE) | (ADC_NUM_CHANNELS - 1);
     /* Wake ADC from power down */
-    ADC1_CR1 |= 1 << ADC1_CR1_ADON;
+    ADC1_CR1 |= (1 << ADC1_CR1_ADON);
+}
 
-    uint8_t adcH, adcL;
+void ADC_startScan()
+{
+    _scanComplete = 0;
+    /* Second ADON write starts the conversion */
     ADC1_CR1 |= (1 << ADC1_CR1_ADON);
-    while (!(ADC1_CSR & (1 << ADC1_CSR_EOC)))
-        ;
-    adcL = ADC1_DRL;
-    adcH = ADC1_DRH;
-    ADC1_CSR &= ~(1 << ADC1_CSR_EOC); // clear EOC flag
-    return (adcL | (adcH << 8));
+}
+
+void ADC_startOnTimer(uint16_t count)
+{
+    /* Only TIM1 TRGO can trigger the ADC, TIM2 channel 2 (internal,
+       output disabled) interrupts at the sample point and starts the scan */
+    TIM2_CCMR2 = 0x00; /* frozen */
+    TIM2_CCR2H = (count >> 8) & 0xff;
+    TIM2_CCR2L = count & 0xff;
+    TIM2_SR1 &= ~(1 << TIM2_SR1_CC2IF);
+    TIM2_IER |= (1 << TIM2_IER_CC2IE);
+}
+
+void ADC_watchdog(uint8_t channel, uint16_t low, uint16_t high)
+{
+    _watchdogChannel = channel;
+    _watchdogLow = low;
+    /* Thresholds are 10 bits, the 8 MSB in the high register whatever the alignment */
+    ADC1_HTRH = (high >> 2) & 0xff;
+    ADC1_HTRL = high & 0x03;
+    ADC1_LTRH = (low >> 2) & 0xff;
+    ADC1_LTRL = low & 0x03;
+    ADC1_AWCRL = (1 << channel);
+    ADC1_CSR |= (1 << ADC1_CSR_AWDIE);
+}
+
+uint8_t ADC_watchdogCheck()
+{
+    disable_interrupts();
+    uint8_t fault = _fault;
+    _fault = 0;
+    if (!fault)
+        PWM_release(PWM_CH1);
+    enable_interrupts();
+    return fault;
+}
+
+void ADC_powerDown()
+{
+    /* Any scan in progress is lost, ADC_init() powers the converter up again */
+    ADC1_CR1 &= ~(1 << ADC1_CR1_ADON);
+    _scanComplete = 0;
+}
+
+uint8_t ADC_takeScan()
+{
+    disable_interrupts();
+    uint8_t complete = _scanComplete;
+    _scanComplete = 0;
+    enable_interrupts();
+    return complete;
+}
+
+uint16_t ADC_sample(uint8_t channel)
+{
+    return _samples[channel];
 }
@@ -26,8 +26,65 @@
 #ifndef _ADC_H_
 #define _ADC_H_
 
-#include <stdint.h>
+#include <stm8s.h>
 
-uint16_t ADC_read(uint8_t channel);
+// Scan sequence CH0..CH(ADC_NUM_CHANNELS - 1)
+#define ADC_CH_TEMP 0 // thermocouple
+#define ADC_CH_UIN 1  // input voltage
+#define ADC_NUM_CHANNELS 2
+
+// Analog watchdog faults, as shown on the display
+#define ADC_FAULT_LOW 1  // ER1: below the low threshold, short on sensor
+#define ADC_FAULT_HIGH 2 // ER2: above the high threshold, sensor is broken
+
+void ADC1_interrupt_handler() __interrupt(ADC1_ISR);
+void TIM2_CC_interrupt_handler() __interrupt(TIM2_CC_ISR);
+
+/*
+ *  Configure ADC1 for a single scan of all channels into the
+ *  data buffer registers, with an interrupt at the end of the scan
+ */
+void ADC_init();
+
+/*
+ *  Start a new scan, returns immediately
+ */
+void ADC_startScan();
+
+/*
+ *  Start a scan every TIM2 period when the counter reaches the given value,
+ *  in sync with the heater PWM
+ */
+void ADC_startOnTimer(uint16_t count);
+
+/*
+ *  Arm the analog watchdog on a channel, a conversion outside of
+ *  low..high switches the heater (PWM_CH1) off from the interrupt and
+ *  latches the fault; the watchdog stays armed across ADC_init()
+ */
+void ADC_watchdog(uint8_t channel, uint16_t low, uint16_t high);
+
+/*
+ *  Latched fault, ADC_FAULT_LOW / ADC_FAULT_HIGH or 0, cleared by the call:
+ *  it is set again by the next conversion out of range. Without a fault
+ *  the heater output is released, in one go with respect to the interrupt
+ */
+uint8_t ADC_watchdogCheck();
+
+/*
+ *  Switch the converter off, for the deep sleep
+ */
+void ADC_powerDown();
+
+/*
+ *  Non-zero once per completed scan: the flag is cleared by the call,
+ *  each scan is taken only once
+ */
+uint8_t ADC_takeScan();
+
+/*
+ *  Latest converted value of the channel, never waits for the converter
+ */
+uint16_t ADC_sample(uint8_t channel);
 
 #endif //_ADC_H_
\ No newline at end of file
@@ -0,0 +1,126 @@
+//
+//  autotune.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <autotune.h>
+
+// A relay of amplitude d and hysteresis h makes the loop oscillate with an
+// amplitude a, the describing function gives the ultimate gain
+//   Ku = 4d / (pi * sqrt(a^2 - h^2))
+// d = TUNE_RELAY / 2 per-mille = 50%, a = peak to peak / 2 degrees:
+//   Ku = 400 / (pi * sqrt(pp^2 - (2h)^2)) % per degree
+// Tyreus-Luyben with the period Pu in control periods:
+//   Kp = Ku / 2.2, Ki = Kp / (2.2 * Pu) per period, Kd = Kp * Pu / 6.3
+#define KP_TIMES_PP 3704 // 64 * 400 / (pi * 2.2), Q6 times peak to peak degrees
+
+void TUNE_start(struct TUNE *tune)
+{
+    tune->state = TUNE_HEATING;
+    tune->output = 1;
+    tune->cycles = 0;
+    tune->time = 0;
+    tune->periodSum = 0;
+    tune->amplitudeSum = 0;
+}
+
+static void fail(struct TUNE *tune)
+{
+    tune->state = TUNE_FAILED;
+    tune->output = 0;
+}
+
+int16_t TUNE_run(struct TUNE *tune, int16_t setPoint, int16_t input)
+{
+    if (tune->state != TUNE_HEATING && tune->state != TUNE_RELAY_CYCLES)
+        return 0;
+    if (++tune->time > TUNE_TIMEOUT)
+    {
+        fail(tune);
+        return 0;
+    }
+
+    if (tune->state == TUNE_RELAY_CYCLES)
+    {
+        tune->max = (input > tune->max) ? input : tune->max;
+        tune->min = (input < tune->min) ? input : tune->min;
+    }
+
+    if (tune->output && input > setPoint + TUNE_HYSTERESIS)
+    {
+        // A cycle ends each time the relay switches OFF
+        tune->output = 0;
+        if (tune->state == TUNE_HEATING)
+        {
+            tune->state = TUNE_RELAY_CYCLES;
+        }
+        else if (++tune->cycles > TUNE_SKIP_CYCLES)
+        {
+            tune->periodSum += tune->time - tune->cycleStart;
+            tune->amplitudeSum += tune->max - tune->min;
+            if (tune->cycles == TUNE_SKIP_CYCLES + TUNE_CYCLES)
+                tune->state = TUNE_DONE;
+        }
+        tune->cycleStart = tune->time;
+        tune->max = input;
+        tune->min = input;
+    }
+    else if (!tune->output && input < setPoint - TUNE_HYSTERESIS)
+    {
+        tune->output = 1;
+    }
+    return tune->output ? TUNE_RELAY : 0;
+}
+
+static uint16_t squareRoot(uint32_t value)
+{
+    uint16_t root = 0;
+    for (uint16_t bit = 1 << 15; bit; bit >>= 1)
+    {
+        uint16_t trial = root | bit;
+        if ((uint32_t)trial * trial <= value)
+            root = trial;
+    }
+    return root;
+}
+
+static uint16_t clampGain(int32_t gain, uint16_t maxGain)
+{
+    return (gain < 1) ? 1 : (gain > maxGain) ? maxGain : (uint16_t)gain;
+}
+
+uint8_t TUNE_gains(const struct TUNE *tune, struct PID_GAINS *gains, uint16_t maxGain)
+{
+    if (tune->state != TUNE_DONE || !tune->periodSum)
+        return 0;
+    // Averages over the cycles: pp = amplitudeSum / N, Pu = periodSum / N
+    uint32_t hysteresis = 2 * TUNE_HYSTERESIS * TUNE_CYCLES;
+    uint32_t amplitude2 = (uint32_t)tune->amplitudeSum * tune->amplitudeSum;
+    if (amplitude2 <= hysteresis * hysteresis)
+        return 0; // no real oscillation, the sensor noise toggled the relay
+    int32_t kp = (int32_t)KP_TIMES_PP * TUNE_CYCLES / squareRoot(amplitude2 - hysteresis * hysteresis);
+    int32_t ki = (kp * 10 * TUNE_CYCLES) / (22L * tune->periodSum);
+    int32_t kd = (kp * 10 * tune->periodSum) / (63L * TUNE_CYCLES);
+    gains->kp = clampGain(kp, maxGain);
+    gains->ki = clampGain(ki, maxGain);
+    gains->kd = clampGain(kd, maxGain);
+    return 1;
+}
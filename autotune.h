@@ -0,0 +1,80 @@
+//
+//  autotune.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef _AUTOTUNE_H_
+#define _AUTOTUNE_H_
+
+#include <stdint.h>
+#include <pid.h>
+
+// Relay experiment: full power below the set point, heater off above it,
+// with TUNE_HYSTERESIS degrees around it against the sensor noise. The
+// tip oscillates, period and amplitude give the ultimate gain and period
+// of the loop and the Tyreus-Luyben rules turn them into PID gains
+#define TUNE_HYSTERESIS 3    // degrees
+#define TUNE_RELAY 1000      // per-mille, relay output when ON
+#define TUNE_SKIP_CYCLES 2   // cycles to settle before measuring
+#define TUNE_CYCLES 4        // cycles averaged
+#define TUNE_TIMEOUT 1800    // control periods, the whole experiment
+
+enum TUNE_STATES
+{
+    TUNE_IDLE,
+    TUNE_HEATING, // full power up to the first crossing of the set point
+    TUNE_RELAY_CYCLES,
+    TUNE_DONE,
+    TUNE_FAILED
+};
+
+struct TUNE
+{
+    uint8_t state;
+    uint8_t output;  // relay ON
+    uint8_t cycles;  // completed cycles
+    uint16_t time;   // control periods since the start
+    uint16_t cycleStart;
+    int16_t max;
+    int16_t min;
+    uint16_t periodSum;    // control periods over the measured cycles
+    uint16_t amplitudeSum; // peak to peak degrees over the measured cycles
+};
+
+/*
+ *  Start the experiment
+ */
+void TUNE_start(struct TUNE *tune);
+
+/*
+ *  Run once per control period instead of the regulator
+ *  out: heater power, per-mille
+ */
+int16_t TUNE_run(struct TUNE *tune, int16_t setPoint, int16_t input);
+
+/*
+ *  Gains from a completed experiment
+ *  in: upper limit of the gains
+ *  out: non-zero if the experiment is complete and the gains are set
+ */
+uint8_t TUNE_gains(const struct TUNE *tune, struct PID_GAINS *gains, uint16_t maxGain);
+
+#endif //_AUTOTUNE_H_
@@ -0,0 +1,51 @@
+//
+//  boost.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <boost.h>
+
+void BOOST_start(struct BOOST *boost, int16_t input)
+{
+    boost->active = 1;
+    boost->periods = 0;
+    boost->lastInput = input;
+    boost->rate = 0;
+}
+
+uint8_t BOOST_run(struct BOOST *boost, int16_t setPoint, int16_t input)
+{
+    if (!boost->active)
+        return 0;
+
+    // Filtered rate of rise, the sensor is quantized to one degree
+    int16_t rise = (input - boost->lastInput) << BOOST_RATE_SHIFT;
+    boost->rate += (rise - boost->rate) >> BOOST_RATE_FILTER;
+    boost->lastInput = input;
+
+    int16_t error = setPoint - input;
+    int16_t overshoot = (boost->rate < 0) ? 0 : (int16_t)(((int32_t)boost->rate * BOOST_LAG) >> BOOST_RATE_SHIFT);
+    if (boost->periods++ == 0 && error < BOOST_MIN_ERROR)
+        boost->active = 0; // close enough, the regulator does better
+    else if (error <= overshoot || boost->periods > BOOST_MAX_PERIODS)
+        boost->active = 0;
+    return boost->active;
+}
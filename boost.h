@@ -0,0 +1,58 @@
+//
+//  boost.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef _BOOST_H_
+#define _BOOST_H_
+
+#include <stdint.h>
+
+// Full power heat-up, the heater is cut off early when the measured rate of
+// rise predicts the overshoot: the sensor lags the tip and the stored heat
+// keeps the reading rising for about BOOST_LAG periods after the cutoff
+#define BOOST_MIN_ERROR 30     // degrees below the set point to start a boost
+#define BOOST_LAG 4            // control periods, overshoot = rate * BOOST_LAG
+#define BOOST_MAX_PERIODS 300  // give up, the sensor does not follow the heater
+#define BOOST_RATE_SHIFT 4     // rate is Q4 degrees per period
+#define BOOST_RATE_FILTER 2    // IIR, 1/4 of the new rate per period
+
+struct BOOST
+{
+    uint8_t active;
+    uint16_t periods;
+    int16_t lastInput;
+    int16_t rate; // Q4 degrees per control period
+};
+
+/*
+ *  Arm a boost, it runs on the next BOOST_run() if the error is large enough
+ */
+void BOOST_start(struct BOOST *boost, int16_t input);
+
+/*
+ *  Run once per control period instead of the regulator
+ *  out: non-zero while the heater has to stay at full power,
+ *       zero once the predicted temperature reaches the set point
+ */
+uint8_t BOOST_run(struct BOOST *boost, int16_t setPoint, int16_t input);
+
+#endif //_BOOST_H_
@@ -26,85 +26,167 @@
 #include <buttons.h>
 #include <stm8s.h>
 #include <stm8s_pins.h>
-#include <delay.h>
-#include <clock.h>
-#include <string.h>
 
-#define DEBOUNCE_TIME 10
-#define MULTICLICK_TIME 180
-#define SHORT_PRESS 300
-#define LONG_PRESS 900
-#define FAST_INCREMENT 40
+#define QUEUE_MASK (BUTTON_QUEUE - 1)
+#define BUTTON_PINS ((1 << 7) | (1 << 6) | (1 << 5))
 
-uint8_t checkButton(struct Button *btn, int16_t *value, int8_t increment, uint32_t nowTime)
+struct ButtonState
 {
-    static uint8_t skipCounter = 0;
-    if (getPin(btn->pin) == LOW)
+    uint8_t mask;       // PB_IDR bit
+    uint8_t debounce;   // ms left before the pin is sampled
+    uint8_t down;
+    uint8_t quickPress; // pressed soon after a click
+    uint8_t repeats;
+    uint16_t held;      // ms since the press
+    uint16_t nextRepeat;
+    uint16_t idle;      // ms since the release
+};
+
+static const uint16_t _defaultCurve[] = {300, 300, 300, 40};
+
+static struct ButtonState _buttons[BTN_COUNT] = {
+    {.mask = 1 << 7}, // BTN_PLUS
+    {.mask = 1 << 6}, // BTN_MINUS
+    {.mask = 1 << 5}, // BTN_MERCURY
+};
+static const uint16_t *_curve = _defaultCurve;
+static uint8_t _curveLength = sizeof(_defaultCurve) / sizeof(_defaultCurve[0]);
+
+// Single producer (the interrupts), single consumer (the tasks)
+static struct BUTTON_EVENT _queue[BUTTON_QUEUE];
+static volatile uint8_t _queueHead = 0; // written by the ISRs only
+static volatile uint8_t _queueTail = 0; // written by BUTTONS_getEvent only
+
+static void pushEvent(uint8_t button, uint8_t type, uint8_t count)
+{
+    uint8_t head = _queueHead;
+    if (((head + 1) & QUEUE_MASK) == _queueTail)
+        return; // full, the consumer is far behind
+    _queue[head].button = button;
+    _queue[head].type = type;
+    _queue[head].count = count;
+    _queueHead = (head + 1) & QUEUE_MASK;
+}
+
+static uint16_t curve(uint8_t repeats)
+{
+    return _curve[(repeats < _curveLength) ? repeats : _curveLength - 1];
+}
+
+void EXTI_PORTB_interrupt_handler() __interrupt(EXTI1_ISR)
+{
+    // Any edge restarts the debounce of the pins that moved
+    static uint8_t lastLevels = BUTTON_PINS;
+    uint8_t levels = PB_IDR & BUTTON_PINS;
+    uint8_t changed = levels ^ lastLevels;
+    lastLevels = levels;
+    for (uint8_t i = 0; i < BTN_COUNT; i++)
     {
-        if (!btn->lastBounceTime)
-            btn->lastBounceTime = nowTime;
-        if (!btn->longPressTimer)
-            btn->longPressTimer = btn->lastBounceTime;
-        if ((nowTime - btn->longPressTimer) > LONG_PRESS)
-        {
-            if (!(skipCounter++ % FAST_INCREMENT))
-            {
-                *value += increment;
-            }
-        }
-        else if ((nowTime - btn->lastBounceTime) > SHORT_PRESS)
-        {
-            *value += increment;
-            btn->lastBounceTime = 0;
-            beep();
-        }
-        if (nowTime - btn->lastBounceTime > DEBOUNCE_TIME)
-        {
-            return HIGH;
-        }
+        if (changed & _buttons[i].mask)
+            _buttons[i].debounce = BUTTON_DEBOUNCE;
     }
-    else
+}
+
+void BUTTONS_init()
+{
+    for (uint8_t i = 0; i < BTN_COUNT; i++)
     {
-        btn->lastBounceTime = 0;
-        btn->longPressTimer = 0;
+        _buttons[i].down = !(PB_IDR & _buttons[i].mask);
+        _buttons[i].idle = BUTTON_MULTICLICK;
     }
-    return LOW;
+    pinMode(PB5, INPUT);
+    pinMode(PB6, INPUT);
+    pinMode(PB7, INPUT);
+    EXTI_CR1 |= (3 << EXTI_CR1_PBIS); // both edges
+    PB_CR2 |= BUTTON_PINS;
 }
 
-uint8_t checkDoubleClick(struct Button *btn, int16_t *value, int8_t increment, uint32_t nowTime)
+static void pressed(struct ButtonState *btn)
 {
-    uint8_t clicks = 0;
-    uint8_t btnState = getPin(btn->pin);
-    // Make the button logic active-high in code
-    btnState = !btnState;
+    btn->quickPress = btn->idle < BUTTON_MULTICLICK;
+    btn->held = 0;
+    btn->repeats = 0;
+    btn->nextRepeat = curve(0);
+}
 
-    // If the switch changed, due to noise or a button press, reset the debounce timer
-    if (btnState != btn->lastState)
+static void released(uint8_t id, struct ButtonState *btn)
+{
+    if (btn->held < BUTTON_LONG_PRESS)
     {
-        btn->lastBounceTime = nowTime;
+        pushEvent(id, BTN_CLICK, 0);
+        if (btn->quickPress)
+        {
+            pushEvent(id, BTN_DOUBLE_CLICK, 0);
+            btn->idle = BUTTON_MULTICLICK; // a third click starts over
+            return;
+        }
+        btn->idle = 0;
     }
-
-    // Debounce the button (check if a stable, changed state has occured)
-    if (nowTime - btn->lastBounceTime > DEBOUNCE_TIME && btnState != btn->depressed)
+    else
     {
-        btn->depressed = btnState;
-        if (!btn->depressed)
-            btn->clickCount++;
+        btn->idle = BUTTON_MULTICLICK;
     }
-    btn->lastState = btnState;
+}
 
-    // If the button released state is stable, report number of clicks and start new cycle
-    if (btn->depressed && (nowTime - btn->lastBounceTime) > MULTICLICK_TIME)
+void BUTTONS_tick()
+{
+    for (uint8_t id = 0; id < BTN_COUNT; id++)
     {
-        // positive count for released buttons
-        clicks = btn->clickCount;
-        btn->clickCount = 0;
-        if (clicks > 1)
+        struct ButtonState *btn = &_buttons[id];
+        if (btn->debounce && !--btn->debounce)
+        {
+            uint8_t down = !(PB_IDR & btn->mask);
+            if (down != btn->down)
+            {
+                btn->down = down;
+                pushEvent(id, down ? BTN_PRESS : BTN_RELEASE, 0);
+                if (id != BTN_MERCURY)
+                    down ? pressed(btn) : released(id, btn);
+            }
+        }
+        if (id == BTN_MERCURY)
+            continue;
+
+        if (!btn->down)
         {
-            *value += increment;
-            beep();
-            return HIGH;
+            if (btn->idle < BUTTON_MULTICLICK)
+                btn->idle++;
+            continue;
+        }
+        if (btn->held < 0xFFFF)
+            btn->held++;
+        if (btn->held == BUTTON_LONG_PRESS)
+            pushEvent(id, BTN_LONG_PRESS, 0);
+        if (btn->held == btn->nextRepeat)
+        {
+            pushEvent(id, BTN_REPEAT, btn->repeats);
+            if (btn->repeats < 0xFF)
+                btn->repeats++;
+            // stops at 0xFFFF, a curve has to be used for a minute to get there
+            btn->nextRepeat = (0xFFFF - btn->held > curve(btn->repeats)) ? btn->held + curve(btn->repeats) : 0xFFFF;
         }
     }
-    return LOW;
-}
\ No newline at end of file
+}
+
+uint8_t BUTTONS_getEvent(struct BUTTON_EVENT *event)
+{
+    uint8_t tail = _queueTail;
+    if (tail == _queueHead)
+        return 0;
+    *event = _queue[tail];
+    _queueTail = (tail + 1) & QUEUE_MASK;
+    return 1;
+}
+
+uint8_t BUTTONS_isDown(uint8_t button)
+{
+    return _buttons[button].down;
+}
+
+void BUTTONS_setRepeatCurve(const uint16_t *intervals, uint8_t count)
+{
+    disable_interrupts();
+    _curve = intervals;
+    _curveLength = count;
+    enable_interrupts();
+}
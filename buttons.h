@@ -26,19 +26,70 @@
 #ifndef _BUTTONS_H_
 #define _BUTTONS_H_
 
-#include <stdint.h>
+#include <stm8s.h>
 
-struct Button
+// Inputs on port B, the mercury switch reports level changes only
+enum BUTTON_IDS
 {
-    uint8_t pin;
-    uint8_t lastState;
-    uint32_t lastBounceTime;
-    uint32_t longPressTimer;
-    uint8_t depressed;
-    uint8_t clickCount;
+    BTN_PLUS,    // PB7
+    BTN_MINUS,   // PB6
+    BTN_MERCURY, // PB5
+    BTN_COUNT
 };
 
-uint8_t checkButton(struct Button *button, int16_t *value, int8_t increment, uint32_t nowTime);
-uint8_t checkDoubleClick(struct Button *btn, int16_t *value, int8_t increment, uint32_t nowTime);
+enum BUTTON_EVENTS
+{
+    BTN_PRESS,        // pin went low
+    BTN_RELEASE,      // pin went high
+    BTN_CLICK,        // released before BUTTON_LONG_PRESS
+    BTN_DOUBLE_CLICK, // second click pressed within BUTTON_MULTICLICK of the first
+    BTN_LONG_PRESS,   // held for BUTTON_LONG_PRESS
+    BTN_REPEAT        // while held, timed by the acceleration curve
+};
+
+#define BUTTON_DEBOUNCE 10   // ms
+#define BUTTON_MULTICLICK 180 // ms
+#define BUTTON_LONG_PRESS 900 // ms
+#define BUTTON_QUEUE 16      // events, must be a power of 2
+
+// Default acceleration curve: three repeats 300 ms apart, then every 40 ms
+#define BUTTON_FAST_REPEAT 3 // first repeat of the fast part of the default curve
+
+struct BUTTON_EVENT
+{
+    uint8_t button;
+    uint8_t type;
+    uint8_t count; // BTN_REPEAT: repeats before this one, saturated at 255
+};
+
+void EXTI_PORTB_interrupt_handler() __interrupt(EXTI1_ISR);
+
+/*
+ *  Configure the pins with interrupts on both edges,
+ *  must be called with the interrupts disabled
+ */
+void BUTTONS_init();
+
+/*
+ *  Debounce and timing, called from the millisecond timer interrupt
+ */
+void BUTTONS_tick();
+
+/*
+ *  Take the oldest event from the queue
+ *  out: non-zero when an event was taken
+ */
+uint8_t BUTTONS_getEvent(struct BUTTON_EVENT *event);
+
+/*
+ *  Debounced state, non-zero while the button is held
+ */
+uint8_t BUTTONS_isDown(uint8_t button);
+
+/*
+ *  Acceleration curve: the n-th repeat comes intervals[n] ms after the
+ *  previous one (the first after the press), the last interval is kept
+ */
+void BUTTONS_setRepeatCurve(const uint16_t *intervals, uint8_t count);
 
 #endif //_BUTTONS_H_
@@ -24,79 +24,109 @@
 //
 
 #include <clock.h>
-#include <main.h>
-
-#define BEEP_DURATION 100
-
-extern struct EEPROM_DATA _eepromData;
+#include <s7c.h>
+#include <prof.h>
+#include <buttons.h>
 
 // internal clock counter, will overflow every 49 days ;)
 volatile uint32_t _currentMsecs = 0;
 
-volatile uint8_t _beep1 = 0;
-volatile uint8_t _beep2 = 0;
-volatile uint8_t _duration = 0;
+#define TIMER_RUNNING 0x40 // flags owned by the ISR
+#define TIMER_EXPIRED 0x80
 
-void TIM4_overflow_handler() __interrupt(TIM4_UPD_OVF)
+struct Timer
 {
-    static uint8_t localCnt = 0;
+    uint16_t count; // ticks left
+    uint16_t period;
+    volatile uint8_t flags;
+};
 
-    if (localCnt++ % 2) // 1kHz clock, 1mS
-        _currentMsecs++;
+// Two wheels turned by the ISR: every millisecond and every second
+static struct Timer _timers[TIMER_COUNT];
+static uint16_t _secondTicks = 0;
 
-    TIM4_SR &= ~1;
-
-    if (_beep1 < BEEP_DURATION)
-    {
-        if (localCnt % 2) // 500Hz
-            PA_ODR ^= (1 << 3);
-        _beep1++;
-    }
-    else if (_beep2 < BEEP_DURATION) // 1kHz
-    {
-        PA_ODR ^= (1 << 3);
-        _beep2++;
-    }
-    else if (_duration) // repeat
+static void timersTick()
+{
+    uint8_t second = (++_secondTicks >= 1000);
+    if (second)
+        _secondTicks = 0;
+    for (uint8_t i = 0; i < TIMER_COUNT; i++)
     {
-        _beep1 = _beep2 = 0;
-        _duration--;
+        struct Timer *timer = &_timers[i];
+        if (!(timer->flags & TIMER_RUNNING) || ((timer->flags & TIMER_SECONDS) && !second))
+            continue;
+        if (--timer->count)
+            continue;
+        if (timer->flags & TIMER_PERIODIC)
+        {
+            timer->count = timer->period;
+            timer->flags |= TIMER_EXPIRED;
+        }
+        else
+        {
+            timer->flags = (timer->flags & ~TIMER_RUNNING) | TIMER_EXPIRED;
+        }
     }
 }
 
-void TIM4_init()
+void TIM4_overflow_handler() __interrupt(TIM4_UPD_OVF)
 {
-    PA_DDR |= (1 << 3); // configure PA3 as output
-    PA_CR1 |= (1 << 3); // push-pull mode
-    PA_CR2 |= (1 << 3); // push-pull mode
+    TIM4_SR &= ~1;
+
+    _currentMsecs++;
+    BUTTONS_tick();
+    timersTick();
+
+    PROF_START_ISR(PROF_REFRESH);
+    S7C_refreshStep(); // 1kHz display multiplexing
+    PROF_STOP_ISR(PROF_REFRESH);
+}
 
+void TIM4_init()
+{
     // F = F_CPU / ( 2 ^ Prescaler * ( 1 + ARR ) )
-    // F = 16 MHz / ( 64 * ( 1 + 124 ) ) = 2kHz
-    TIM4_PSCR = 6;
+    // F = 16 MHz / ( 128 * ( 1 + 124 ) ) = 1kHz
+    TIM4_PSCR = 7;
     TIM4_ARR = 0x7c;
     TIM4_IER = (1 << TIM4_IER_UIE);
     TIM4_CR1 = (1 << TIM4_CR1_CEN);
 }
 
-void beep()
+void TIMER_start(uint8_t timer, uint16_t count, uint8_t flags)
+{
+    count = count ? count : 1;
+    disable_interrupts();
+    _timers[timer].count = count;
+    _timers[timer].period = count;
+    _timers[timer].flags = flags | TIMER_RUNNING;
+    enable_interrupts();
+}
+
+void TIMER_stop(uint8_t timer)
+{
+    _timers[timer].flags = 0; // single byte write, the ISR leaves stopped timers alone
+}
+
+uint8_t TIMER_running(uint8_t timer)
 {
-    if (!_eepromData.enableSound)
-        return;
-    _beep1 = 0;
-    _beep2 = 0;
-    _duration = 0;
+    return _timers[timer].flags & TIMER_RUNNING;
 }
 
-void beepAlarm()
+uint8_t TIMER_expired(uint8_t timer)
 {
-    if (!_eepromData.enableSound)
-        return;
-    _beep1 = 0;
-    _beep2 = 0;
-    _duration = 3;
+    if (!(_timers[timer].flags & TIMER_EXPIRED))
+        return 0;
+    disable_interrupts();
+    _timers[timer].flags &= ~TIMER_EXPIRED;
+    enable_interrupts();
+    return 1;
 }
 
 uint32_t currentMillis()
 {
-    return _currentMsecs;
+    // 32-bit counter is updated by the interrupt, read it in one go
+    disable_interrupts();
+    uint32_t msecs = _currentMsecs;
+    enable_interrupts();
+    return msecs;
 }
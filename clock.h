@@ -35,7 +35,42 @@ void TIM4_init();
 
 uint32_t currentMillis();
 
-void beep();
-void beepAlarm();
+// Software timers counted down by the TIM4 tick, milliseconds or seconds
+enum TIMER_IDS
+{
+    TIMER_SLEEP,             // SL1 timeout, restarted when the iron moves
+    TIMER_DEEPSLEEP,         // SL2 timeout
+    TIMER_DEEPSLEEP_DELAY,   // alarm before halting
+    TIMER_HEATPOINT_DISPLAY, // target shown after a key press
+    TIMER_SAVE,              // settings written after the last change
+    TIMER_MENU_DISPLAY,      // menu page name shown
+    TIMER_TIP_DISPLAY,       // selected tip shown after a tip change
+    TIMER_COUNT
+};
+
+#define TIMER_SECONDS 0x01  // count seconds instead of milliseconds
+#define TIMER_PERIODIC 0x02 // reload on expiry
+
+/*
+ *  Start or restart a timer
+ *  in: timer, count in milliseconds or seconds (at least 1),
+ *      TIMER_SECONDS and/or TIMER_PERIODIC
+ */
+void TIMER_start(uint8_t timer, uint16_t count, uint8_t flags);
+
+/*
+ *  Stop a timer, a pending expiry is dropped
+ */
+void TIMER_stop(uint8_t timer);
+
+/*
+ *  Non-zero while the timer counts down
+ */
+uint8_t TIMER_running(uint8_t timer);
+
+/*
+ *  Non-zero once after each expiry, the flag is cleared by the call
+ */
+uint8_t TIMER_expired(uint8_t timer);
 
 #endif //_CLOCK_H_
\ No newline at end of file
@@ -0,0 +1,126 @@
+//
+//  command.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <stm8s.h>
+#include <string.h>
+#include <main.h>
+#include <telemetry.h>
+#include <watchdog.h>
+#include <command.h>
+
+#define SETTINGS_WORDS (sizeof(struct EEPROM_DATA) / 2)
+#define MAX_PAYLOAD (4 + sizeof(struct EEPROM_DATA)) // largest request or reply
+
+extern struct EEPROM_DATA _eepromData;
+
+// Both frames stay off the stack, a reply is queued with the telemetry
+static uint8_t _request[MAX_PAYLOAD + 4];
+static uint8_t _reply[MAX_PAYLOAD + 4];
+static struct EEPROM_DATA _settings; // the settings being checked
+
+// Range of words of the request, 0 when it does not fit in the struct
+static uint8_t wordRange(uint8_t first, uint8_t count)
+{
+    return count && first < SETTINGS_WORDS && count <= SETTINGS_WORDS - first;
+}
+
+/* Executes the request, the payload of the reply follows the status
+    in: request payload and its length, reply payload
+    out: reply payload length
+*/
+static uint8_t execute(const uint8_t *request, uint8_t length, uint8_t *reply)
+{
+    uint8_t first = request[1];
+    uint8_t count = request[2];
+    reply[0] = request[0] | CMD_REPLY;
+    reply[1] = CMD_BAD_REQUEST;
+
+    switch (request[0])
+    {
+    case CMD_READ:
+        if (length != 3 || !wordRange(first, count))
+            return 2;
+        reply[2] = first;
+        reply[3] = count;
+        memcpy(reply + 4, (uint16_t *)&_eepromData + first, count * 2);
+        reply[1] = CMD_OK;
+        return 4 + count * 2;
+    case CMD_WRITE:
+        if (length != 3 + count * 2 || !wordRange(first, count))
+            return 2;
+        _settings = _eepromData;
+        memcpy((uint16_t *)&_settings + first, request + 3, count * 2);
+        reply[1] = applySettings(&_settings, 0) ? CMD_OK : CMD_BAD_VALUE;
+        return 2;
+    case CMD_APPLY:
+        if (length != 1 + sizeof(_settings))
+            return 2;
+        memcpy(&_settings, request + 1, sizeof(_settings));
+        reply[1] = applySettings(&_settings, 1) ? CMD_OK : CMD_BAD_VALUE;
+        return 2;
+    case CMD_HEATPOINT:
+        if (length != 1 && length != 3)
+            return 2;
+        reply[1] = CMD_OK;
+        if (length == 3)
+        {
+            _settings = _eepromData;
+            memcpy(&_settings.profile.heatPoint, request + 1, 2);
+            reply[1] = applySettings(&_settings, 0) ? CMD_OK : CMD_BAD_VALUE;
+        }
+        int16_t degrees[2] = {targetHeatPoint(), currentDegrees()};
+        memcpy(reply + 2, degrees, sizeof(degrees));
+        return 2 + sizeof(degrees);
+    case CMD_RESET_LOG:
+        if (length != 1)
+            return 2;
+        WATCHDOG_resetLog((struct RESET_LOG *)(reply + 2));
+        reply[1] = CMD_OK;
+        return 2 + sizeof(struct RESET_LOG);
+    case CMD_TIP:
+        if (length != 1 && length != 2)
+            return 2;
+        reply[1] = CMD_OK;
+        if (length == 2 && request[1] >= TIP_PROFILES)
+            reply[1] = CMD_BAD_VALUE;
+        else if (length == 2 && !selectTip(request[1]))
+            reply[1] = CMD_BUSY;
+        reply[2] = _eepromData.tip;
+        return 3;
+    }
+    return 2;
+}
+
+void COMMAND_init()
+{
+    TELEMETRY_init();
+}
+
+void COMMAND_task(uint32_t nowTime)
+{
+    uint8_t length = TELEMETRY_receiveFrame(_request, sizeof(_request));
+    if (!length)
+        return;
+    length = execute(_request + 3, length, _reply + 3);
+    TELEMETRY_sendFrame(_reply, length); // dropped when the telemetry fills the buffer
+}
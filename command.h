@@ -0,0 +1,68 @@
+//
+//  command.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef _COMMAND_H_
+#define _COMMAND_H_
+
+#include <stdint.h>
+
+#define COMMAND_PERIOD 10 // ms, requests polled from the serial port
+
+/*
+ *  Requests and replies use the telemetry framing
+ *  | 0xA5 | 0x5A | length of payload | payload | sum of payload bytes |
+ *  The payload starts with the command, the reply with the command | CMD_REPLY
+ *  and a status. Settings are addressed as 16-bit words of struct EEPROM_DATA,
+ *  in its memory order.
+ */
+enum COMMANDS
+{
+    CMD_READ = 1,  // first word, count -> first word, count, words
+    CMD_WRITE,     // first word, count, words -> saved after EEPROM_SAVE_TIMEOUT
+    CMD_APPLY,     // all the words -> checked as a whole and saved at once
+    CMD_HEATPOINT, // [degrees] -> target and current degrees
+    CMD_RESET_LOG, // -> struct RESET_LOG
+    CMD_TIP,       // [tip] -> selected tip, its profile is loaded
+};
+
+#define CMD_REPLY 0x80
+
+enum COMMAND_STATUS
+{
+    CMD_OK,
+    CMD_BAD_REQUEST, // unknown command, wrong length or words out of the struct
+    CMD_BAD_VALUE,   // a setting out of its range, nothing is changed
+    CMD_BUSY,        // the EEPROM is being written, retry later
+};
+
+/*
+ *  Start the serial port
+ */
+void COMMAND_init();
+
+/*
+ *  Serve the pending requests, scheduler task
+ */
+void COMMAND_task(uint32_t nowTime);
+
+#endif //_COMMAND_H_
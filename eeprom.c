@@ -25,18 +25,27 @@
 
 #include <eeprom.h>
 #include <string.h>
-#include <s7c.h>
-#include <clock.h>
 
-void eeprom_unlock()
+// Polls until the status flag is set, at most EEPROM_MAX_POLLS times
+static uint8_t pollStatus(uint8_t flag)
+{
+    for (uint16_t polls = 0; polls < EEPROM_MAX_POLLS; polls++)
+    {
+        if (FLASH_IAPSR & (1 << flag))
+            return 1;
+    }
+    return 0;
+}
+
+uint8_t eeprom_unlock()
 {
     if (!(FLASH_IAPSR & (1 << FLASH_IAPSR_DUL)))
     {
         FLASH_DUKR = FLASH_DUKR_KEY1;
         FLASH_DUKR = FLASH_DUKR_KEY2;
-        while (!(FLASH_IAPSR & (1 << FLASH_IAPSR_DUL)))
-            ;
+        return pollStatus(FLASH_IAPSR_DUL);
     }
+    return 1;
 }
 
 void option_bytes_unlock()
@@ -50,10 +59,9 @@ void eeprom_lock()
     FLASH_IAPSR &= ~(1 << FLASH_IAPSR_DUL);
 }
 
-void eeprom_wait_busy()
+uint8_t eeprom_wait_busy()
 {
-    while (!(FLASH_IAPSR & (1 << FLASH_IAPSR_EOP)))
-        ;
+    return pollStatus(FLASH_IAPSR_EOP);
 }
 
 void eeprom_read(uint16_t addr, void *buf, int len)
@@ -65,13 +73,250 @@ void eeprom_read(uint16_t addr, void *buf, int len)
 
 void eeprom_write(uint16_t addr, void *buf, int len)
 {
-    eeprom_unlock();
-    uint8_t *eeAddress = (uint8_t *)addr;
+    if (!eeprom_unlock())
+        return;
+    volatile uint8_t *eeAddress = &_MEM_(addr);
     uint8_t *storage = (uint8_t *)buf;
+    for (uint8_t i = 0; i < len; i++, eeAddress++)
+    {
+        if (*eeAddress != storage[i])
+        {
+            *eeAddress = storage[i];
+            if (!eeprom_wait_busy())
+                break;
+        }
+    }
+    eeprom_lock();
+}
+
+/*
+ *  Wear-leveled record log
+ *
+ *  slot: | seq | data ... | crc | padding to EEPROM_WORD_SIZE |
+ */
+
+#define EEPROM_SIZE (EEPROM_END_ADDR - EEPROM_START_ADDR + 1)
+#define NO_SLOT 0xFF
+
+static uint8_t _logSlot = NO_SLOT; // slot of the newest record
+static uint8_t _logSeq = 0;        // sequence number of the newest record
+
+static uint8_t slotSize(uint8_t len)
+{
+    // seq + data + crc, rounded up to whole words
+    return (len + 2 + EEPROM_WORD_SIZE - 1) & ~(EEPROM_WORD_SIZE - 1);
+}
+
+static uint16_t slotAddress(uint8_t slot, uint8_t len)
+{
+    return EEPROM_START_ADDR + slot * slotSize(len);
+}
+
+static uint8_t crc8(uint8_t crc, uint8_t data)
+{
+    crc ^= data;
+    for (uint8_t i = 0; i < 8; i++)
+        crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+    return crc;
+}
+
+// The sequence number is part of the CRC, an erased (all zero) slot never matches
+static uint8_t recordCrc(uint8_t seq, const uint8_t *data, uint8_t len)
+{
+    uint8_t crc = crc8(0xFF, seq);
     for (uint8_t i = 0; i < len; i++)
+        crc = crc8(crc, data[i]);
+    return crc;
+}
+
+static uint8_t slotIsValid(uint16_t addr, uint8_t len)
+{
+    return recordCrc(_MEM_(addr), (const uint8_t *)&_MEM_(addr + 1), len) == _MEM_(addr + 1 + len);
+}
+
+uint8_t eeprom_load(void *buf, uint8_t len)
+{
+    uint8_t numSlots = EEPROM_SIZE / slotSize(len);
+    _logSlot = NO_SLOT;
+    for (uint8_t slot = 0; slot < numSlots; slot++)
+    {
+        uint16_t addr = slotAddress(slot, len);
+        if (!slotIsValid(addr, len))
+            continue;
+        // serial number arithmetic, survives the 8-bit wrap around
+        uint8_t seq = _MEM_(addr);
+        if (_logSlot == NO_SLOT || (int8_t)(seq - _logSeq) > 0)
+        {
+            _logSlot = slot;
+            _logSeq = seq;
+        }
+    }
+    if (_logSlot == NO_SLOT)
+        return 0;
+    eeprom_read(slotAddress(_logSlot, len) + 1, buf, len);
+    return 1;
+}
+
+/*
+ *  Background writer
+ *
+ *  The record is copied to a shadow buffer and programmed one word per
+ *  eeprom_saveStep() call, the end of each word is polled with EOP
+ *  (cleared by reading FLASH_IAPSR, which is read once per step).
+ *  eeprom_writeAsync() shares the writer for plain data out of the log.
+ */
+
+enum WriterStates
+{
+    WRITER_IDLE,
+    WRITER_UNLOCK,  // keys written, waiting for DUL
+    WRITER_PROGRAM, // next word to program
+    WRITER_WAIT     // word programming in progress
+};
+
+static uint8_t _shadow[EEPROM_MAX_RECORD + 2 + EEPROM_WORD_SIZE - 1]; // seq + data + crc, whole words
+static uint8_t _writerState = WRITER_IDLE;
+static uint8_t _writerSlot;
+static uint8_t _writerLog;    // a log record, the newest one when written
+static uint16_t _writerAddr;  // first word
+static uint8_t _writerSize;   // bytes, whole words
+static uint8_t _writerOffset; // next word
+static uint16_t _writerPolls;    // steps spent waiting for the current flag
+static uint16_t _writerMaxPolls; // steps before giving up
+
+static void eeprom_write_word(uint16_t addr, const uint8_t *word)
+{
+    FLASH_CR2 |= (1 << FLASH_CR2_WPRG);
+    FLASH_NCR2 &= ~(1 << FLASH_NCR2_NWPRG);
+    for (uint8_t i = 0; i < EEPROM_WORD_SIZE; i++)
+        _MEM_(addr + i) = word[i];
+}
+
+static void startWriter(uint16_t addr)
+{
+    _writerAddr = addr;
+    _writerState = WRITER_UNLOCK;
+    _writerPolls = 0;
+    _writerMaxPolls = EEPROM_MAX_STEPS;
+    FLASH_DUKR = FLASH_DUKR_KEY1;
+    FLASH_DUKR = FLASH_DUKR_KEY2;
+}
+
+uint8_t eeprom_saveAsync(void *buf, uint8_t len)
+{
+    const uint8_t *data = (const uint8_t *)buf;
+    if (len > EEPROM_MAX_RECORD || (_writerState != WRITER_IDLE && !_writerLog))
+        return 0;
+
+    // Delta only: nothing to do when the newest record already holds the data.
+    // A write in progress is restarted with the data instead, it may be
+    // complete but for its commit and would be loaded at the next boot
+    if (_writerState == WRITER_IDLE && _logSlot != NO_SLOT &&
+        !memcmp((const void *)&_MEM_(slotAddress(_logSlot, len) + 1), data, len))
+        return 1;
+
+    // A new save restarts a write in progress, in the same slot
+    if (_writerState == WRITER_IDLE)
     {
-        *eeAddress++ = storage[i];
-        S7C_refreshDisplay(currentMillis());
+        uint8_t numSlots = EEPROM_SIZE / slotSize(len);
+        _writerSlot = (_logSlot == NO_SLOT || _logSlot + 1 >= numSlots) ? 0 : _logSlot + 1;
+        _writerLog = 1;
+        startWriter(slotAddress(_writerSlot, len));
     }
-    //eeprom_lock();
-}
\ No newline at end of file
+    uint8_t seq = _logSeq + 1;
+    _writerSize = slotSize(len);
+    memset(_shadow, 0, sizeof(_shadow));
+    _shadow[0] = seq;
+    memcpy(_shadow + 1, data, len);
+    _shadow[len + 1] = recordCrc(seq, data, len);
+    _writerOffset = 0;
+    return 1;
+}
+
+uint8_t eeprom_writeAsync(uint16_t addr, void *buf, uint8_t len)
+{
+    if (len > EEPROM_MAX_RECORD || _writerState != WRITER_IDLE)
+        return 0;
+    // The bytes of the last word after the data keep their value
+    _writerSize = (len + EEPROM_WORD_SIZE - 1) & ~(EEPROM_WORD_SIZE - 1);
+    memcpy(_shadow, (const void *)&_MEM_(addr), _writerSize);
+    memcpy(_shadow, buf, len);
+    _writerOffset = 0;
+    _writerLog = 0;
+    startWriter(addr);
+    return 1;
+}
+
+uint8_t eeprom_busy()
+{
+    return _writerState != WRITER_IDLE;
+}
+
+uint8_t eeprom_saveStep()
+{
+    uint8_t status = FLASH_IAPSR;
+    if ((_writerState == WRITER_UNLOCK || _writerState == WRITER_WAIT) && ++_writerPolls > _writerMaxPolls)
+    {
+        // Unlock or programming never completed, the previous record stays the newest
+        eeprom_lock();
+        _writerState = WRITER_IDLE;
+        return 0;
+    }
+    switch (_writerState)
+    {
+    case WRITER_UNLOCK:
+        if (!(status & (1 << FLASH_IAPSR_DUL)))
+            return 1;
+        _writerState = WRITER_PROGRAM;
+        // fall through
+    case WRITER_PROGRAM:
+    {
+        uint16_t addr = _writerAddr;
+        for (; _writerOffset < _writerSize; _writerOffset += EEPROM_WORD_SIZE)
+        {
+            // Words already holding the data are skipped
+            if (memcmp((const void *)&_MEM_(addr + _writerOffset), _shadow + _writerOffset, EEPROM_WORD_SIZE))
+            {
+                eeprom_write_word(addr + _writerOffset, _shadow + _writerOffset);
+                _writerOffset += EEPROM_WORD_SIZE;
+                _writerState = WRITER_WAIT;
+                _writerPolls = 0;
+                return 1;
+            }
+        }
+        eeprom_lock();
+        if (_writerLog)
+        {
+            _logSlot = _writerSlot;
+            _logSeq = _shadow[0];
+        }
+        _writerState = WRITER_IDLE;
+        return 0;
+    }
+    case WRITER_WAIT:
+        if (status & (1 << FLASH_IAPSR_WR_PG_DIS))
+        {
+            // Write protected, give up, the previous record stays the newest
+            eeprom_lock();
+            _writerState = WRITER_IDLE;
+            return 0;
+        }
+        if (status & (1 << FLASH_IAPSR_EOP))
+            _writerState = WRITER_PROGRAM;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+void eeprom_save(void *buf, uint8_t len)
+{
+    // Back to back steps, the flags are polled as long as in the blocking write;
+    // a plain write in progress is finished first
+    _writerMaxPolls = EEPROM_MAX_POLLS;
+    while (!eeprom_saveAsync(buf, len))
+        eeprom_saveStep();
+    _writerMaxPolls = EEPROM_MAX_POLLS;
+    while (eeprom_saveStep())
+        ;
+}
@@ -44,14 +44,76 @@
 #define OPT5 _MEM_(0x4809)
 #define NOPT5 _MEM_(0x480A)
 
+#define EEPROM_WORD_SIZE 4
+#define EEPROM_MAX_RECORD 48 // bytes of data in a log record, the size of the shadow buffer
+#define EEPROM_MAX_POLLS 20000 // status polls before giving up, well over a word programming time
+#define EEPROM_MAX_STEPS 4     // eeprom_saveStep() calls waiting before giving up, 5 ms apart over three times the 6 ms worst word time
+
 void eeprom_read(uint16_t addr, void *buf, int len);
 
+/**
+ * Program the buffer, bytes already holding the right value are skipped.
+ * Gives up when the EEPROM does not unlock or a byte does not complete.
+ */
 void eeprom_write(uint16_t addr, void *buf, int len);
 
+/**
+ * Load the newest valid record of the wear-leveled log spread over
+ * EEPROM_START_ADDR..EEPROM_END_ADDR.
+ * Each record is a sequence number, the data and a CRC-8, stored in
+ * word aligned slots used in turn.
+ * Returns 0 if the log holds no valid record of this length.
+ */
+uint8_t eeprom_load(void *buf, uint8_t len);
+
+/**
+ * Append the data to the log in the slot after the newest record,
+ * using word programming and skipping words that already match.
+ * Nothing is written when the data equals the newest record.
+ * eeprom_load() must be called first to find the newest record.
+ * Blocks until the record is written, see eeprom_saveAsync(), each flag
+ * is polled at most EEPROM_MAX_POLLS times.
+ */
+void eeprom_save(void *buf, uint8_t len);
+
+/**
+ * Same as eeprom_save() in the background: the data is copied at once
+ * and written by the following eeprom_saveStep() calls. A new save
+ * restarts a write in progress with the new data, in the same slot.
+ * At most EEPROM_MAX_RECORD bytes.
+ * Returns 0 while an eeprom_writeAsync() is in progress, retry later.
+ */
+uint8_t eeprom_saveAsync(void *buf, uint8_t len);
+
+/**
+ * Plain background write of data out of the log, at a word aligned
+ * address: the data is copied at once and written by the following
+ * eeprom_saveStep() calls, words already holding it are skipped.
+ * At most EEPROM_MAX_RECORD bytes.
+ * Returns 0 when a write is in progress, retry later.
+ */
+uint8_t eeprom_writeAsync(uint16_t addr, void *buf, uint8_t len);
+
+/**
+ * Non-zero while a background write is in progress.
+ */
+uint8_t eeprom_busy();
+
+/**
+ * Program the next word of the background write, never waits for the
+ * flash: a word in progress is polled with EOP. The EEPROM is locked
+ * again when the data is complete, or when the unlock or a word is
+ * still pending after EEPROM_MAX_STEPS steps. The steps are meant to be
+ * a few milliseconds apart, see eeprom_save() for back to back steps.
+ * Returns 0 when there is nothing left to write.
+ */
+uint8_t eeprom_saveStep();
+
 /**
  * Enable write access to EEPROM.
+ * Returns 0 when the unlock did not happen within EEPROM_MAX_POLLS.
  */
-void eeprom_unlock();
+uint8_t eeprom_unlock();
 
 /**
  * Enable write access to option bytes.
@@ -67,7 +129,8 @@ void eeprom_lock();
 /**
  * Wait until programming is finished.
  * Not necessary on devices with no RWW support.
+ * Returns 0 when it did not finish within EEPROM_MAX_POLLS.
  */
-void eeprom_wait_busy();
+uint8_t eeprom_wait_busy();
 
 #endif /* _EEPROM_H_ */
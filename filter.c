@@ -0,0 +1,56 @@
+//
+//  filter.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <filter.h>
+
+void FILTER_init(struct FILTER *f, uint8_t log2Samples, uint8_t extraBits, uint16_t initial)
+{
+    f->log2Samples = (log2Samples > FILTER_MAX_LOG2_SAMPLES) ? FILTER_MAX_LOG2_SAMPLES : log2Samples;
+    f->extraBits = (extraBits > f->log2Samples) ? f->log2Samples : extraBits;
+    f->count = 0;
+    f->value = initial << f->extraBits;
+}
+
+uint8_t FILTER_add(struct FILTER *f, uint16_t sample)
+{
+    if (f->count == 0)
+    {
+        f->sum = f->min = f->max = sample;
+    }
+    else
+    {
+        f->sum += sample;
+        if (sample < f->min)
+            f->min = sample;
+        if (sample > f->max)
+            f->max = sample;
+    }
+
+    if (++f->count < (1 << f->log2Samples) + 2)
+        return 0;
+
+    // Trimmed mean, decimated
+    f->value = (f->sum - f->min - f->max) >> (f->log2Samples - f->extraBits);
+    f->count = 0;
+    return 1;
+}
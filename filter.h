@@ -0,0 +1,55 @@
+//
+//  filter.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef _FILTER_H_
+#define _FILTER_H_
+
+#include <stdint.h>
+
+// Block of 2^log2Samples + 2 samples, the smallest and the largest are
+// dropped as outliers and the rest is averaged, decimation keeps extraBits
+// more bits of resolution (up to log2Samples / 2 bits are meaningful)
+#define FILTER_MAX_LOG2_SAMPLES 5 // the sum of 10 bit samples fits 16 bits
+
+struct FILTER
+{
+    uint8_t log2Samples;
+    uint8_t extraBits;
+    uint8_t count;
+    uint16_t min;
+    uint16_t max;
+    uint16_t sum;
+    uint16_t value; // latest output, in 1/2^extraBits of the sample units
+};
+
+/*
+ *  Configure the filter, the output starts from the given sample value
+ */
+void FILTER_init(struct FILTER *f, uint8_t log2Samples, uint8_t extraBits, uint16_t initial);
+
+/*
+ *  Add a sample, non-zero when a block is complete and the value is updated
+ */
+uint8_t FILTER_add(struct FILTER *f, uint16_t sample);
+
+#endif //_FILTER_H_
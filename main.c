@@ -26,14 +26,25 @@
 #include <stm8s.h>
 #include <stm8s_pins.h>
 #include <main.h>
-#include <delay.h>
 #include <pwm.h>
 #include <s7c.h>
 #include <adc.h>
+#include <uart.h>
 #include <eeprom.h>
 #include <clock.h>
+#include <sound.h>
 #include <menu.h>
 #include <buttons.h>
+#include <pid.h>
+#include <boost.h>
+#include <scheduler.h>
+#include <power.h>
+#include <watchdog.h>
+#include <filter.h>
+#include <telemetry.h>
+#include <command.h>
+#include <prof.h>
+#include <stack.h>
 
 #ifndef F_CPU
 #warning "F_CPU not defined, using 16MHz by default"
@@ -45,202 +56,461 @@ enum WorkingModes
     NORMAL_MODE,
     FORCED_MODE,
     SLEEP_MODE,
-    DEEPSLEEP_MODE
+    DEEPSLEEP_MODE,
+    MENU_MODE
 };
 
-#define MIN_HEAT 50
-#define MAX_HEAT 450
 #define MAX_ADC_RT 130
 #define MIN_ADC_RT 35
-
-#define PWM_POWER_OFF 100
+#define SENSOR_SHORT_ADC 10  // ER1 below
+#define SENSOR_OPEN_ADC 1000 // ER2 above
+
+#define MAX_POWER 1000 // per-mille
+#define HEATER_COUNTS(power) ((uint16_t)((uint32_t)(power) * PWM_PERIOD / MAX_POWER))
+#define PID_PERIOD 100
+#define SENSORS_PERIOD 1
+#define BUTTONS_PERIOD 1
+#define DISPLAY_PERIOD 10
+#define SLEEP_DISPLAY_PERIOD 50 // ms, display updates while sleeping, the sun still flashes
+#define EEPROM_PERIOD 5 // one word of a settings write per run
 #define SLEEP_TEMP 100
 #define EEPROM_SAVE_TIMEOUT 2000
 #define HEATPOINT_DISPLAY_DELAY 2500
 
-uint32_t _haveToSaveData = 0;
-static uint32_t _sleepTimer = 0;
-static uint32_t _heatPointDisplayTime = 0;
+#ifndef TELEMETRY_PERIOD
+#define TELEMETRY_PERIOD 100 // ms, 0 disables the telemetry stream
+#endif
+
+// Sensor filters: 2^N + 2 samples per output, outliers dropped
+// the sensors are sampled once per PWM period (8 ms) in the heater OFF window
+#define TEMP_FILTER_LOG2_SAMPLES 2 // 48 ms, two bits more for the thermocouple
+#define UIN_FILTER_LOG2_SAMPLES 1  // 32 ms
+#define DEEPSLEEP_DELAY 1000 // let the alarm sound before halting
+
+// Tip change: the thermocouple is open while the tip is out, the analog
+// watchdog has already switched the heater off
+#define TIP_SWAP_PERIODS 3      // control periods open before it counts as a tip change
+#define TIP_DISPLAY_DELAY 3000  // ms, the tip is shown and can be changed with the keys
+#define TIP_STORE_ADDR (RESET_LOG_ADDR + sizeof(struct RESET_LOG)) // profiles of all the tips
+#define TIP_STRIDE ((sizeof(struct TIP_PROFILE) + EEPROM_WORD_SIZE - 1) & ~(EEPROM_WORD_SIZE - 1))
+#define TIP_ADDRESS(tip) (TIP_STORE_ADDR + (tip) * TIP_STRIDE) // whole words, written in the background
+#define NO_TIP 0xFF
+
+// Input voltage, the heater power goes with its square. The PID gains are
+// tuned on the 24V supply, lower supplies get a longer duty for the same power
+#define UIN_REFERENCE_ADC 680                      // input voltage reading at 24V
+#define UIN_LOW_ADC (UIN_REFERENCE_ADC * 15 / 24)  // under-voltage below 15V
+#define UIN_HYSTERESIS (UIN_REFERENCE_ADC / 24)    // 1V
+
 static uint8_t _currentState = NORMAL_MODE;
+static uint8_t _sleepSensorState = 0;
+static uint8_t _calibrationPoint = 0;
 
 struct EEPROM_DATA _eepromData;
-struct Button _btnPlus = {PB7, 0, 0, 0, 0, 0};
-struct Button _btnMinus = {PB6, 0, 0, 0, 0, 0};
+static struct PID _pid;
+static struct BOOST _boost;
+static struct TUNE _tune;
+
+// Shared between the tasks
+static struct FILTER _tempFilter;
+static struct FILTER _uinFilter;
+static uint16_t _adcTemp = MIN_ADC_RT << TC_EXTRA_BITS; // filtered thermocouple, TC_EXTRA_BITS fraction
+static uint16_t _adcUIn = UIN_REFERENCE_ADC;            // filtered input voltage
+static int16_t _currentDegrees = 0;
+static int16_t _targetHeatPoint = 0;
+static int16_t _heaterPower = 0;
+static uint8_t _sensorError = 0;
+static uint8_t _underVoltage = 0;
+static uint8_t _tipOutPeriods = 0; // control periods with the thermocouple open
 
 void deepSleep();
-uint8_t checkSleep(uint32_t nowTime);
+uint8_t checkSleep();
+void restartSleepTimers();
 void checkHeatPointValidity();
+void sensorsTask(uint32_t nowTime);
+void buttonsTask(uint32_t nowTime);
+void controlTask(uint32_t nowTime);
+void displayTask(uint32_t nowTime);
+void telemetryTask(uint32_t nowTime);
 
 void setup()
 {
+#if PROFILING
+    // Before anything else runs deeper than setup() itself
+    STACK_paint();
+#endif
     // Configure the clock for maximum speed on the 16MHz HSI oscillator
     // At startup the clock output is divided by 8
     CLK_CKDIVR = 0x0;
+    // Record why we were reset, then a stuck task resets us again
+    WATCHDOG_init();
     disable_interrupts();
     TIM4_init();
+    SOUND_init();
+    // Configure mercury sensor and button pins, edges are debounced by the TIM4 ISR
+    BUTTONS_init();
     enable_interrupts();
 
-    // Configure mercury sensor and button pins
-    pinMode(PB5, INPUT);
-    pinMode(PB7, INPUT);
-    pinMode(PB7, INPUT);
-
     // Configure 7-segments display
     S7C_init();
 
+    // Configure ADC, the first scan runs while we finish the setup
+    FILTER_init(&_tempFilter, TEMP_FILTER_LOG2_SAMPLES, TC_EXTRA_BITS, MIN_ADC_RT);
+    FILTER_init(&_uinFilter, UIN_FILTER_LOG2_SAMPLES, 0, UIN_REFERENCE_ADC);
+    ADC_init();
+    ADC_watchdog(ADC_CH_TEMP, SENSOR_SHORT_ADC, SENSOR_OPEN_ADC);
+    ADC_startScan();
+
     // Configure PWM
     pinMode(PD4, OUTPUT);
-    PWM_init(PWM_CH1);
-    PWM_duty(PWM_CH1, 100); // set heater OFF
+    PWM_init(PWM_CH1, PWM_PRESCALER, PWM_PERIOD);
+    PWM_dutyRaw(PWM_CH1, PWM_RAW_OFF); // set heater OFF
+    ADC_startOnTimer(PWM_samplePoint());
 
-    _sleepTimer = currentMillis();
-    _heatPointDisplayTime = _sleepTimer + HEATPOINT_DISPLAY_DELAY;
+    TIMER_start(TIMER_HEATPOINT_DISPLAY, HEATPOINT_DISPLAY_DELAY, 0);
 
     // EEPROM
-    eeprom_read(EEPROM_START_ADDR, &_eepromData, sizeof(_eepromData));
-    // First launch, eeprom empty OR -button pressed when power the device
-    if (_eepromData.heatPoint == 0 || getPin(PB6) == LOW)
+    // First launch, no valid record in the log OR -button pressed when power the device
+    if (!eeprom_load(&_eepromData, sizeof(_eepromData)) || getPin(PB6) == LOW)
     {
-        _eepromData.heatPoint = 270;
+        _eepromData.tip = 0;
+        _eepromData.profile.heatPoint = 270;
         _eepromData.enableSound = 1;
-        _eepromData.calibrationValue = 0;
+        _eepromData.profile.calibrationValue = 0;
         _eepromData.sleepTimeout = 3;       // 3 min, heatPoint 100C
         _eepromData.deepSleepTimeout = 10;  // 10 min, heatPoint 0
         _eepromData.forceModeIncrement = 0; // 0 degrees
-        eeprom_write(EEPROM_START_ADDR, &_eepromData, sizeof(_eepromData));
+        _eepromData.boostOnWake = 1;
+        PID_defaultGains(&_eepromData.profile.pidGains);
+        TC_defaultTable(_eepromData.profile.tcTable, MIN_ADC_RT, MIN_HEAT, MAX_ADC_RT, MAX_HEAT);
+        eeprom_save(&_eepromData, sizeof(_eepromData));
+        // Every tip starts again from the defaults, see selectTip()
+        for (uint8_t tip = 0; tip < TIP_PROFILES; tip++)
+        {
+            uint16_t unused = 0;
+            eeprom_write(TIP_ADDRESS(tip), &unused, sizeof(unused));
+        }
     }
+    TC_init(_eepromData.profile.tcTable);
+    restartSleepTimers();
+    PID_init(&_pid, 0, MAX_POWER);
+    BOOST_start(&_boost, 0); // cold start at full power
 
     beepAlarm();
+    SCHED_addTask(beepTask, BEEP_PERIOD);
+    SCHED_addTask(checkPendingDataSave, EEPROM_PERIOD);
+
+    // The heater is switched ON by the regulator in controlTask
+    SCHED_addTask(sensorsTask, SENSORS_PERIOD);
+    SCHED_addTask(controlTask, PID_PERIOD);
+#if TELEMETRY_PERIOD
+    TELEMETRY_init();
+    SCHED_addTask(telemetryTask, TELEMETRY_PERIOD);
+#endif
+#if PROFILING
+    TELEMETRY_init();
+    PROF_init();
+    SCHED_addTask(PROF_report, PROF_PERIOD);
+#endif
+    COMMAND_init();
+    SCHED_addTask(COMMAND_task, COMMAND_PERIOD);
+
     // Press +button when power the device will enter to Setup Menu
     if (getPin(PB7) == LOW)
     {
+        _currentState = MENU_MODE;
         setup_menu();
+        return;
     }
 
-    // Now we can switch ON the heater at 50%
-    PWM_duty(PWM_CH1, 50);
+    SCHED_addTask(buttonsTask, BUTTONS_PERIOD);
+    SCHED_addTask(displayTask, DISPLAY_PERIOD);
 }
 
-void mainLoop()
+void sensorsTask(uint32_t nowTime)
 {
-    static uint16_t localCnt = 0;
-
-    uint8_t displaySymbol = 0;
-    uint32_t nowTime = currentMillis();
-
-    // Input power sensor
-    static uint16_t oldADCUI = 0;
-    uint16_t adcUIn = ADC_read(ADC1_CSR_CH1);
-    adcUIn = ((oldADCUI * 7) + adcUIn) >> 3; // noise filter
-    oldADCUI = adcUIn;
-
-    // Temperature sensor
-    static uint16_t oldADCVal = MIN_ADC_RT;
-    uint16_t adcVal = ADC_read(ADC1_CSR_CH0);
-    adcVal = ((oldADCVal * 7) + adcVal) >> 3; // noise filter
-    oldADCVal = adcVal;
+    // Sensors are converted in the PWM OFF window, filter only fresh samples
+    PROF_START(PROF_SENSORS);
+    if (ADC_takeScan())
+    {
+        // Input power sensor
+        if (FILTER_add(&_uinFilter, ADC_sample(ADC_CH_UIN)))
+        {
+            _adcUIn = _uinFilter.value;
+            _underVoltage = _underVoltage ? (_adcUIn < UIN_LOW_ADC + UIN_HYSTERESIS) : (_adcUIn < UIN_LOW_ADC);
+        }
+        // Temperature sensor
+        if (FILTER_add(&_tempFilter, ADC_sample(ADC_CH_TEMP)))
+            _adcTemp = _tempFilter.value;
+    }
+    PROF_STOP(PROF_SENSORS);
+}
 
-    // Degrees value
-    adcVal = (adcVal < MIN_ADC_RT) ? MIN_ADC_RT : adcVal;
-    int16_t currentDegrees = (MAX_HEAT - MIN_HEAT) * (adcVal - MIN_ADC_RT) / (MAX_ADC_RT - MIN_ADC_RT);
-    currentDegrees += _eepromData.calibrationValue;
+#define CHORD ((1 << BTN_PLUS) | (1 << BTN_MINUS))
 
-    // ER1: short on sensor
-    // ER2: sensor is broken
-    uint8_t error = (adcVal < 10) ? 1 : (adcVal > 1000) ? 2 : 0;
-    if (!error)
+void buttonsTask(uint32_t nowTime)
+{
+    struct BUTTON_EVENT event;
+    // The chord follows the events, not the debounced state: when both presses
+    // are taken in the same run only the second one completes it
+    static uint8_t held = 0;       // buttons pressed, as seen from the events
+    static uint8_t chordArmed = 1; // toggles once, until both are released
+    static uint8_t wantedTip = NO_TIP; // refused by selectTip() while the EEPROM is written
+    if (_sensorError)
     {
-        PWM_duty(PWM_CH1, 100); // switch OFF the heater
-        S7C_setChars("ER");
-        S7C_setDigit(2, error);
-        S7C_refreshDisplay(nowTime);
-        beep();
+        while (BUTTONS_getEvent(&event))
+            ; // nothing to adjust until the sensor is fixed
+        held = 0;
+        chordArmed = 1;
+        wantedTip = NO_TIP;
         return;
     }
 
+    PROF_START(PROF_BUTTONS);
+    // Check for buttons, any mercury switch change means the iron is in use
+    static uint8_t chordState = MENU_MODE; // mode before the two buttons toggled it, MENU_MODE when none
+    uint8_t bothDown = BUTTONS_isDown(BTN_PLUS) && BUTTONS_isDown(BTN_MINUS);
+    uint8_t choosingTip = TIMER_running(TIMER_TIP_DISPLAY);
+    uint8_t tip = (wantedTip != NO_TIP) ? wantedTip : _eepromData.tip;
+    while (BUTTONS_getEvent(&event))
+    {
+        if (event.button == BTN_MERCURY)
+        {
+            restartSleepTimers();
+            continue;
+        }
+        // when any buttons were pressed we will display target temperature
+        TIMER_start(TIMER_HEATPOINT_DISPLAY, HEATPOINT_DISPLAY_DELAY, 0);
+        if (event.type == BTN_PRESS)
+            held |= (1 << event.button);
+        else if (event.type == BTN_RELEASE)
+            held &= ~(1 << event.button);
+
+        if (event.type == BTN_RELEASE)
+        {
+            chordState = MENU_MODE;
+            chordArmed = chordArmed || !held;
+        }
+        else if (event.type == BTN_PRESS && held == CHORD && chordArmed) // two butons were pressed
+        {
+            chordArmed = 0;
+            beepAlarm();
+            chordState = _currentState;
+            _currentState = (_currentState == FORCED_MODE) ? NORMAL_MODE : FORCED_MODE;
+        }
+        else if (event.type == BTN_LONG_PRESS && bothDown && chordState != MENU_MODE)
+        {
+            // Two buttons held: next tip instead of the mode change
+            _currentState = chordState;
+            chordState = MENU_MODE;
+            wantedTip = (tip + 1 < TIP_PROFILES) ? tip + 1 : 0;
+        }
+        else if (event.type == BTN_CLICK && choosingTip && !bothDown)
+        {
+            tip += (event.button == BTN_PLUS) ? 1 : TIP_PROFILES - 1;
+            wantedTip = (tip < TIP_PROFILES) ? tip : tip - TIP_PROFILES;
+        }
+        else if (event.type == BTN_REPEAT && !bothDown && !choosingTip)
+        {
+            _eepromData.profile.heatPoint += (event.button == BTN_PLUS) ? 1 : -1;
+            if (event.count < BUTTON_FAST_REPEAT)
+                beep();
+            checkHeatPointValidity();
+            scheduleDataSave();
+        }
+    }
+    if (BUTTONS_isDown(BTN_PLUS) || BUTTONS_isDown(BTN_MINUS))
+        TIMER_start(TIMER_HEATPOINT_DISPLAY, HEATPOINT_DISPLAY_DELAY, 0);
+    // A refused tip change is retried until the writes are done
+    if (wantedTip != NO_TIP && selectTip(wantedTip))
+        wantedTip = NO_TIP;
+
     // Check for sleep
     static uint8_t oldSleepState = 0;
-    uint8_t sleepState = checkSleep(nowTime);
+    uint8_t sleepState = checkSleep();
     if (sleepState != oldSleepState)
     {
         beepAlarm();
+        // Picked up again, get back to the working temperature at full power
+        if (sleepState == NORMAL_MODE && _eepromData.boostOnWake)
+            BOOST_start(&_boost, _currentDegrees);
         _currentState = sleepState;
         oldSleepState = sleepState;
+        TIMER_start(TIMER_DEEPSLEEP_DELAY, DEEPSLEEP_DELAY, 0);
+    }
+    if (_currentState == DEEPSLEEP_MODE && !TIMER_running(TIMER_DEEPSLEEP_DELAY))
+    {
+        // Blocks until the iron is moved, the next checkSleep() wakes us up
+        PROF_STOP(PROF_BUTTONS);
+        deepSleep();
+        restartSleepTimers();
+        if (_eepromData.boostOnWake)
+            BOOST_start(&_boost, _currentDegrees);
+        return;
     }
+    PROF_STOP(PROF_BUTTONS);
+}
+
+// Requested power in per-mille of the power at the reference supply
+static int16_t supplyFeedForward(int16_t power)
+{
+    uint32_t uin2 = (uint32_t)_adcUIn * _adcUIn;
+    if (!uin2)
+        return power;
+    uint32_t duty = (uint32_t)power * ((uint32_t)UIN_REFERENCE_ADC * UIN_REFERENCE_ADC) / uin2;
+    return (duty > MAX_POWER) ? MAX_POWER : (int16_t)duty;
+}
+
+void controlTask(uint32_t nowTime)
+{
+    PROF_START(PROF_CONTROL);
+    // Degrees value, piecewise linear calibration table
+    _currentDegrees = TC_degrees(_adcTemp) + _eepromData.profile.calibrationValue;
 
-    // Check for buttons
-    static uint8_t oldAction = 0;
-    uint16_t oldHeatPoint = _eepromData.heatPoint;
-    uint8_t action = checkButton(&_btnPlus, &_eepromData.heatPoint, 1, nowTime) +  // ADD button
-                     checkButton(&_btnMinus, &_eepromData.heatPoint, -1, nowTime); // MINUS button
-    if (action)
+    // ER1: short on sensor
+    // ER2: sensor is broken
+    // the analog watchdog switches the heater off as soon as a conversion is out
+    // of range, the filtered value catches what stays just inside the thresholds
+    uint16_t adcVal = _adcTemp >> TC_EXTRA_BITS;
+    _sensorError = (adcVal < SENSOR_SHORT_ADC) ? ADC_FAULT_LOW : (adcVal > SENSOR_OPEN_ADC) ? ADC_FAULT_HIGH : 0;
+    if (_sensorError)
+        PWM_forceOff(PWM_CH1);
+    else
+        _sensorError = ADC_watchdogCheck();
+    if (_sensorError)
     {
-        // when any buttons were pressed we will display target temperature
-        _heatPointDisplayTime = nowTime + HEATPOINT_DISPLAY_DELAY;
-        if (action != oldAction && action > 1) // two butons were pressed
-        {
-            beepAlarm();
-            _currentState = (_currentState == FORCED_MODE) ? NORMAL_MODE : FORCED_MODE;
-        }
-        if (oldHeatPoint != _eepromData.heatPoint)
-        {
-            checkHeatPointValidity();
-            _haveToSaveData = nowTime;
-        }
+        _heaterPower = 0;
+        PWM_dutyRaw(PWM_CH1, PWM_RAW_OFF); // switch OFF the heater
+        beep();
+        if (_sensorError != ADC_FAULT_HIGH)
+            _tipOutPeriods = 0;
+        else if (_tipOutPeriods < TIP_SWAP_PERIODS)
+            _tipOutPeriods++;
+        PROF_STOP(PROF_CONTROL);
+        return;
+    }
+    if (_tipOutPeriods >= TIP_SWAP_PERIODS)
+    {
+        // A tip was put in, cold: back to the heat point at full power,
+        // the tip is shown so another profile can be picked
+        PID_reset(&_pid, _currentDegrees);
+        BOOST_start(&_boost, 0); // same as the cold start
+        restartSleepTimers();
+        TIMER_start(TIMER_TIP_DISPLAY, TIP_DISPLAY_DELAY, 0);
     }
-    oldAction = action;
+    _tipOutPeriods = 0;
 
     // Set target temperature
-    int16_t targetHeatPoint = 0;
     switch (_currentState)
     {
     case SLEEP_MODE:
-        targetHeatPoint = SLEEP_TEMP;
+        _targetHeatPoint = SLEEP_TEMP;
         break;
     case DEEPSLEEP_MODE:
-        targetHeatPoint = 0;
+        _targetHeatPoint = 0;
+        break;
+    case MENU_MODE:
+        // Heater stays OFF in the menu, except on the calibration and the auto-tune pages
+        _targetHeatPoint = _calibrationPoint ? _eepromData.profile.tcTable[_calibrationPoint] + _eepromData.profile.calibrationValue : (_tune.state == TUNE_HEATING || _tune.state == TUNE_RELAY_CYCLES) ? _eepromData.profile.heatPoint : 0;
         break;
     case FORCED_MODE:
-        targetHeatPoint = _eepromData.heatPoint + _eepromData.forceModeIncrement;
-        targetHeatPoint = targetHeatPoint > MAX_HEAT ? MAX_HEAT : targetHeatPoint;
+        _targetHeatPoint = _eepromData.profile.heatPoint + _eepromData.forceModeIncrement;
+        _targetHeatPoint = _targetHeatPoint > MAX_HEAT ? MAX_HEAT : _targetHeatPoint;
         break;
     case NORMAL_MODE:
     default:
-        targetHeatPoint = _eepromData.heatPoint;
+        _targetHeatPoint = _eepromData.profile.heatPoint;
     }
 
     // Setup heater
-    // 50 degrees before the heatPoint we start to slow down the heater
-    // before that we keep the heater at 50%
-    // if the diff is negative, we'll stop the heater
-    int16_t diff = targetHeatPoint - currentDegrees;
-    int16_t pwmVal = (diff < 0) ? PWM_POWER_OFF : (diff > 50) ? 50 : 90 - diff;
-    PWM_duty(PWM_CH1, pwmVal);
+    // PID regulator gives the heater power in per-mille, runs every PID_PERIOD
+    // the PWM output is inverted: the heater is ON for the first counts of the period
+    if (_tune.state == TUNE_HEATING || _tune.state == TUNE_RELAY_CYCLES)
+    {
+        _heaterPower = TUNE_run(&_tune, _targetHeatPoint, _currentDegrees);
+        if (_tune.state == TUNE_DONE)
+        {
+            if (TUNE_gains(&_tune, &_eepromData.profile.pidGains, PID_MAX_GAIN))
+                scheduleDataSave();
+            else
+                _tune.state = TUNE_FAILED;
+        }
+        PID_reset(&_pid, _currentDegrees);
+    }
+    else if (BOOST_run(&_boost, _targetHeatPoint, _currentDegrees))
+    {
+        // Full power until the predicted overshoot, the PID then starts from
+        // the measured temperature with a cleared integral, the tip coasts up
+        _heaterPower = MAX_POWER;
+        PID_reset(&_pid, _currentDegrees);
+    }
+    else
+    {
+        _heaterPower = PID_compute(&_pid, &_eepromData.profile.pidGains, _targetHeatPoint, _currentDegrees);
+    }
+    PWM_dutyRaw(PWM_CH1, HEATER_COUNTS(supplyFeedForward(_heaterPower)));
+    PROF_STOP(PROF_CONTROL);
+}
+
+void displayTask(uint32_t nowTime)
+{
+    static uint16_t localCnt = 0;
+    uint8_t displaySymbol = 0;
+
+    localCnt++;
+    PROF_START(PROF_DISPLAY);
+
+    // Sleeping, a dim display is updated twenty times a second
+    uint8_t sleeping = !_sensorError && (_currentState == SLEEP_MODE || _currentState == DEEPSLEEP_MODE);
+    S7C_setDimming(sleeping ? S7C_DIM_SLEEP : S7C_DIM_OFF);
+    if (sleeping && (localCnt % (SLEEP_DISPLAY_PERIOD / DISPLAY_PERIOD)))
+    {
+        PROF_STOP(PROF_DISPLAY);
+        return;
+    }
+
+    if (_sensorError)
+    {
+        S7C_setChars("ER");
+        S7C_setDigit(2, _sensorError);
+        PROF_STOP(PROF_DISPLAY);
+        return;
+    }
 
     // Setup display value
     // We will show the current heatPoint
     //   * if any button is pressed
-    //   * till _heatPointDisplayTime timeout is reached
+    //   * till TIMER_HEATPOINT_DISPLAY is running
     //   * when the current temperature is in range ±10 degrees
-    uint16_t displayVal = (currentDegrees < 0) ? 0 : currentDegrees;
-    uint8_t tempInRange = (displayVal >= targetHeatPoint - 10) && (displayVal <= targetHeatPoint + 10);
-    if (nowTime < _heatPointDisplayTime || tempInRange)
+    uint16_t displayVal = (_currentDegrees < 0) ? 0 : _currentDegrees;
+    uint8_t tempInRange = (displayVal >= _targetHeatPoint - 10) && (displayVal <= _targetHeatPoint + 10);
+    if (TIMER_running(TIMER_HEATPOINT_DISPLAY) || tempInRange)
     {
-        displayVal = targetHeatPoint;
+        displayVal = _targetHeatPoint;
         displaySymbol |= SYM_TEMP;
     }
 
     // Setup status symbol, flashing using local counter overflow
-    displaySymbol |= (_currentState >= SLEEP_MODE) && ((localCnt / 500) % 2) ? SYM_MOON : 0; // 1Hz flashing moon
-    displaySymbol |= pwmVal < 100 && ((localCnt / 50) % 2) ? SYM_SUN : 0;                    // 10Hz flashing heater
-    displaySymbol |= (_currentState == FORCED_MODE) ? SYM_FARS : 0;                          // F
+    displaySymbol |= (_currentState >= SLEEP_MODE) && ((localCnt / (500 / DISPLAY_PERIOD)) % 2) ? SYM_MOON : 0; // 1Hz flashing moon
+    displaySymbol |= _heaterPower > 0 && ((localCnt / (50 / DISPLAY_PERIOD)) % 2) ? SYM_SUN : 0;              // 10Hz flashing heater
+    displaySymbol |= (_currentState == FORCED_MODE) ? SYM_FARS : 0;                                           // F
 
-    if (_currentState != DEEPSLEEP_MODE)
+    if (TIMER_running(TIMER_TIP_DISPLAY))
+    {
+        // Selected tip, "t 1".."t 4"
+        S7C_setChars("t");
+        S7C_setDigit(2, _eepromData.tip + 1);
+        displaySymbol &= ~SYM_TEMP;
+    }
+    else if (_underVoltage && _currentState != DEEPSLEEP_MODE && ((localCnt / (500 / DISPLAY_PERIOD)) % 2))
+    {
+        // Weak power supply, alternates with the temperature at 1Hz
+        S7C_setChars("LO ");
+    }
+    else if (_currentState != DEEPSLEEP_MODE)
     {
         displaySymbol |= SYM_CELS;
-        S7C_setDigit(0, displayVal / 100);
-        S7C_setDigit(1, (displayVal / 10) % 10);
-        S7C_setDigit(2, displayVal % 10);
+        S7C_setNumber(0, 3, displayVal);
     }
     else
     {
@@ -250,75 +520,209 @@ void mainLoop()
         S7C_setSymbol(2, 0);
     }
     S7C_setSymbol(3, displaySymbol);
+    PROF_STOP(PROF_DISPLAY);
+}
 
-    checkPendingDataSave(nowTime);
-    S7C_refreshDisplay(nowTime);
-    localCnt++;
-    delay_ms(1);
+void telemetryTask(uint32_t nowTime)
+{
+    static struct TELEMETRY_FRAME frame;
+    frame.state = _currentState;
+    frame.time = nowTime;
+    frame.adcTempRaw = ADC_sample(ADC_CH_TEMP);
+    frame.adcTemp = _adcTemp;
+    frame.adcUIn = _adcUIn;
+    frame.currentDegrees = _currentDegrees;
+    frame.targetHeatPoint = _targetHeatPoint;
+    frame.heaterPower = _heaterPower / (MAX_POWER / 100);
+    TELEMETRY_send(&frame);
 }
 
-uint8_t checkSleep(uint32_t nowTime)
+uint8_t checkSleep()
 {
-    static uint8_t oldSensorState = 0;
-    uint8_t sensorState = getPin(PB5);
-    if (sensorState != oldSensorState)
+    // The timers are restarted by the mercury switch events
+    if (!TIMER_running(TIMER_DEEPSLEEP))
     {
-        _sleepTimer = nowTime;
-        oldSensorState = sensorState;
-        return NORMAL_MODE;
-    }
-    else if ((nowTime - _sleepTimer) > _eepromData.deepSleepTimeout * 60000)
-    {
-        //deepSleep();
         return DEEPSLEEP_MODE;
     }
-    else if ((nowTime - _sleepTimer) > _eepromData.sleepTimeout * 60000)
+    else if (!TIMER_running(TIMER_SLEEP))
     {
         return SLEEP_MODE;
     }
     return NORMAL_MODE;
 }
 
+void restartSleepTimers()
+{
+    TIMER_start(TIMER_SLEEP, _eepromData.sleepTimeout * 60, TIMER_SECONDS);
+    TIMER_start(TIMER_DEEPSLEEP, _eepromData.deepSleepTimeout * 60, TIMER_SECONDS);
+}
+
 void checkHeatPointValidity()
 {
-    if (_eepromData.heatPoint > MAX_HEAT)
-        _eepromData.heatPoint = MAX_HEAT;
-    if (_eepromData.heatPoint < MIN_HEAT)
-        _eepromData.heatPoint = MIN_HEAT;
+    if (_eepromData.profile.heatPoint > MAX_HEAT)
+        _eepromData.profile.heatPoint = MAX_HEAT;
+    if (_eepromData.profile.heatPoint < MIN_HEAT)
+        _eepromData.profile.heatPoint = MIN_HEAT;
 }
 
-void checkPendingDataSave(uint32_t nowTime)
+void setCalibrationPoint(uint8_t point)
 {
-    if (_haveToSaveData && (nowTime - _haveToSaveData) > EEPROM_SAVE_TIMEOUT)
+    if (point != _calibrationPoint)
     {
-        S7C_setSymbol(3, SYM_SAVE);
-        eeprom_write(EEPROM_START_ADDR, &_eepromData, sizeof(_eepromData));
-        _haveToSaveData = 0;
+        PID_reset(&_pid, _currentDegrees);
+        _calibrationPoint = point;
     }
 }
 
-void deepSleep()
+void scheduleDataSave()
 {
-    static uint16_t localCnt = 0;
-    PWM_duty(PWM_CH1, 100); // set heater OFF
-    // Set blank display
-    S7C_setSymbol(0, 0);
-    S7C_setSymbol(1, 0);
-    S7C_setSymbol(2, 0);
-    while (1)
+    TIMER_start(TIMER_SAVE, EEPROM_SAVE_TIMEOUT, 0);
+}
+
+static uint8_t validProfile(const struct TIP_PROFILE *profile)
+{
+    if (profile->heatPoint < MIN_HEAT || profile->heatPoint > MAX_HEAT)
+        return 0;
+    if (profile->calibrationValue < -MAX_CALIB_VAL || profile->calibrationValue > MAX_CALIB_VAL)
+        return 0;
+    if (profile->pidGains.kp > PID_MAX_GAIN || profile->pidGains.ki > PID_MAX_GAIN || profile->pidGains.kd > PID_MAX_GAIN)
+        return 0;
+    // The calibration points are increasing, the ends follow them
+    if (profile->tcTable[1] < 0 || profile->tcTable[TC_NUM_POINTS - 2] > MAX_CALIB_DEGREES)
+        return 0;
+    for (uint8_t point = 2; point < TC_NUM_POINTS - 1; point++)
     {
-        uint8_t displaySymbol = ((localCnt / 500) % 2) ? SYM_MOON : 0; // 1Hz flashing moon
-        S7C_setSymbol(3, displaySymbol);
-        S7C_refreshDisplay(localCnt++);
-        delay_ms(1);
+        if (profile->tcTable[point] <= profile->tcTable[point - 1])
+            return 0;
     }
+    return 1;
+}
+
+static uint8_t validSettings(const struct EEPROM_DATA *data)
+{
+    if (!validProfile(&data->profile) || data->tip != _eepromData.tip)
+        return 0;
+    if (data->enableSound > 1 || data->boostOnWake > 1)
+        return 0;
+    if (data->sleepTimeout < 1 || data->sleepTimeout > MAX_SLEEP_MINS)
+        return 0;
+    if (data->deepSleepTimeout < data->sleepTimeout || data->deepSleepTimeout > MAX_DEEPSLEEP_MINS)
+        return 0;
+    if (data->forceModeIncrement > MAX_FORCE_VAL)
+        return 0;
+    return 1;
+}
+
+uint8_t applySettings(struct EEPROM_DATA *data, uint8_t saveNow)
+{
+    TC_extrapolateEnds(data->profile.tcTable);
+    if (!validSettings(data))
+        return 0;
+    _eepromData = *data;
+    TC_init(_eepromData.profile.tcTable);
+    // The whole record is written in one go, a reset never leaves half of it
+    TIMER_start(TIMER_SAVE, saveNow ? 1 : EEPROM_SAVE_TIMEOUT, 0);
+    return 1;
+}
+
+// Profile of the previous tip, written by checkPendingDataSave()
+static struct TIP_PROFILE _storeProfile;
+static uint8_t _storeTip = NO_TIP;
+
+uint8_t selectTip(uint8_t tip)
+{
+    static struct TIP_PROFILE profile;
+    if (tip >= TIP_PROFILES)
+        return 0;
+    TIMER_start(TIMER_TIP_DISPLAY, TIP_DISPLAY_DELAY, 0);
+    if (tip == _eepromData.tip)
+        return 1;
+
+    // The tip store is read only once the previous writes are done
+    if (_storeTip != NO_TIP || eeprom_busy())
+        return 0;
+    _storeProfile = _eepromData.profile;
+    _storeTip = _eepromData.tip;
+    eeprom_read(TIP_ADDRESS(tip), &profile, sizeof(profile));
+    if (validProfile(&profile))
+        _eepromData.profile = profile;
+    _eepromData.tip = tip;
+    TC_init(_eepromData.profile.tcTable);
+    PID_reset(&_pid, _currentDegrees);
+    BOOST_start(&_boost, _currentDegrees);
+    beepAlarm();
+    scheduleDataSave();
+    return 1;
+}
+
+int16_t targetHeatPoint()
+{
+    return _targetHeatPoint;
+}
+
+int16_t currentDegrees()
+{
+    return _currentDegrees;
+}
+
+void setAutoTune(uint8_t run)
+{
+    uint8_t running = (_tune.state == TUNE_HEATING || _tune.state == TUNE_RELAY_CYCLES);
+    if (run && !running)
+        TUNE_start(&_tune);
+    else if (!run && running)
+        _tune.state = TUNE_IDLE;
+}
+
+const struct TUNE *autoTuneState()
+{
+    return &_tune;
+}
+
+void checkPendingDataSave(uint32_t nowTime)
+{
+    // The settings and the profile of the previous tip are copied at once
+    // and written in the background, one after the other
+    if (_storeTip != NO_TIP && eeprom_writeAsync(TIP_ADDRESS(_storeTip), &_storeProfile, sizeof(_storeProfile)))
+        _storeTip = NO_TIP;
+    if (TIMER_expired(TIMER_SAVE) && !eeprom_saveAsync(&_eepromData, sizeof(_eepromData)))
+        TIMER_start(TIMER_SAVE, EEPROM_PERIOD, 0);
+    if (eeprom_saveStep())
+        S7C_setSymbol(3, SYM_SAVE);
+}
+
+// Run on every AWU wake-up while in the deep sleep
+static uint8_t deepSleepCheck()
+{
+    setPin(PD4, HIGH); // keep the heater OFF
+    return getPin(PB5) != _sleepSensorState || getPin(PB6) == LOW || getPin(PB7) == LOW;
+}
+
+void deepSleep()
+{
+    // Heater OFF, the pin is held by its GPIO register while TIM2 is stopped
+    _heaterPower = 0;
+    PWM_dutyRaw(PWM_CH1, PWM_RAW_OFF);
+    setPin(PD4, HIGH);
+    PWM_stop(PWM_CH1);
+    ADC_powerDown();
+    SOUND_stop();
+
+    _sleepSensorState = getPin(PB5);
+    // The display refresh ISR must not light a segment again after the blank
+    disable_interrupts();
+    S7C_blank();
+    POWER_deepSleep(deepSleepCheck);
+
+    // Woken up, restart the sensors and the heater, the regulator starts over
+    ADC_init();
+    ADC_startScan();
+    PID_reset(&_pid, _currentDegrees);
+    PWM_start(PWM_CH1);
 }
 
 void main()
 {
     setup();
-    while (1)
-    {
-        mainLoop();
-    }
+    SCHED_run();
 }
@@ -27,17 +27,88 @@
 #define _MAIN_H_
 
 #include <stdint.h>
+#include <pid.h>
+#include <tcouple.h>
+#include <autotune.h>
 
-struct EEPROM_DATA
+// Settings bounds, shared by the service menu and the command interface
+#define MIN_HEAT 50
+#define MAX_HEAT 450
+#define MAX_CALIB_VAL 99
+#define MAX_SLEEP_MINS 30
+#define MAX_DEEPSLEEP_MINS 60
+#define MAX_FORCE_VAL 100
+#define MAX_CALIB_DEGREES 999
+
+#define TIP_PROFILES 4 // tips with their own settings
+
+// Settings that go with the tip
+struct TIP_PROFILE
 {
     uint16_t heatPoint;
     int16_t calibrationValue;
+    struct PID_GAINS pidGains;
+    int16_t tcTable[TC_NUM_POINTS]; // thermocouple calibration, degrees
+};
+
+struct EEPROM_DATA
+{
+    struct TIP_PROFILE profile; // of the selected tip, the others are in the tip store
+    uint16_t tip;               // selected tip, 0..TIP_PROFILES - 1
     uint16_t enableSound;
     uint16_t sleepTimeout;
     uint16_t deepSleepTimeout;
     uint16_t forceModeIncrement;
+    uint16_t boostOnWake; // full power heat-up when leaving the sleep modes
 };
 
+/*
+ *  Write the settings EEPROM_SAVE_TIMEOUT after the last change
+ */
+void scheduleDataSave();
 void checkPendingDataSave(uint32_t nowTime);
 
+/*
+ *  Check the settings and make them the current ones, the ends of the
+ *  thermocouple table are extrapolated from the calibration points.
+ *  New sleep timeouts apply from the next wake up. The tip can't be
+ *  changed this way, see selectTip().
+ *  in: settings, non-zero writes them at once instead of after EEPROM_SAVE_TIMEOUT
+ *  out: 0 when a value is out of range, nothing is changed then
+ */
+uint8_t applySettings(struct EEPROM_DATA *data, uint8_t saveNow);
+
+/*
+ *  Keep the profile of the current tip in the tip store and load the
+ *  profile of the new one, a tip never used starts with a copy of the
+ *  current profile. The store is written in the background.
+ *  out: 0 when the tip is out of range or the EEPROM is being written,
+ *       the tip is not changed then
+ */
+uint8_t selectTip(uint8_t tip);
+
+/*
+ *  Regulated and measured tip temperatures, degrees
+ */
+int16_t targetHeatPoint();
+int16_t currentDegrees();
+
+/*
+ *  Regulate at the calibration table point so the thermocouple settles
+ *  exactly on its ADC breakpoint, 0 switches the heater off
+ */
+void setCalibrationPoint(uint8_t point);
+
+/*
+ *  Relay auto-tune of the PID gains at the heat point, the new gains
+ *  are saved when the experiment completes
+ *  in: non-zero starts a new experiment, zero stops a running one
+ */
+void setAutoTune(uint8_t run);
+
+/*
+ *  The last experiment, for the display
+ */
+const struct TUNE *autoTuneState();
+
 #endif //_MAIN_H_
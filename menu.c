@@ -26,140 +26,206 @@
 #include <stm8s.h>
 #include <stm8s_pins.h>
 #include <main.h>
-#include <delay.h>
 #include <eeprom.h>
 #include <clock.h>
+#include <sound.h>
 #include <s7c.h>
 #include <buttons.h>
+#include <scheduler.h>
 
 #define abs(x) (((x) < 0) ? -(x) : (x))
 
 #define MENU_DISPLAY_DELAY 1000
+#define MENU_PERIOD 1
 #define MULTICLICK_TIME 250
 #define MINUS_SYM 0x40
 
-#define MAX_CALIB_VAL 99
-#define MAX_SLEEP_MINS 30
-#define MAX_DEEPSLEEP_MINS 60
-#define MAX_FORCE_VAL 100
+// Item flags: the low bits hold the number of digits the value is rendered with
+#define MENU_DIGITS 0x03
+#define MENU_TOGGLE 0x04       // any button flips the value between 0 and 1
+#define MENU_TC_POINT 0x08     // thermocouple table point, kept monotonic
+#define MENU_AFTER_SLEEP 0x10  // never shorter than the sleep timeout
+#define MENU_AUTOTUNE 0x20     // auto-tune status page, no value
 
-enum
+struct MENU_ITEM
 {
-    ENABLE_SOUND,
-    CALIBRATION_VAL,
-    SLEEP1_VAL,
-    SLEEP2_VAL,
-    FORCE_VAL,
+    char name[4];
+    int16_t *value; // field of _eepromData
+    int16_t min;
+    int16_t max;
+    uint8_t step;
+    uint8_t flags;
 };
 
-static uint32_t _menuDisplayTime = 0;
-static char *_menuNames[] = {"SOU", "CAL", "SL1", "SL2", "FRC"};
-
-extern struct Button _btnPlus;
-extern struct Button _btnMinus;
-extern uint32_t _haveToSaveData;
 extern struct EEPROM_DATA _eepromData;
 
-//
-//  TODO:
-//
-void setup_menu()
+static const struct MENU_ITEM _menuItems[] = {
+    {"SOU", (int16_t *)&_eepromData.enableSound, 0, 1, 1, MENU_TOGGLE | 1},
+    {"CAL", &_eepromData.profile.calibrationValue, -MAX_CALIB_VAL, MAX_CALIB_VAL, 1, 2},
+    {"CP1", &_eepromData.profile.tcTable[1], 0, MAX_CALIB_DEGREES, 1, MENU_TC_POINT | 3},
+    {"CP2", &_eepromData.profile.tcTable[2], 0, MAX_CALIB_DEGREES, 1, MENU_TC_POINT | 3},
+    {"CP3", &_eepromData.profile.tcTable[3], 0, MAX_CALIB_DEGREES, 1, MENU_TC_POINT | 3},
+    {"CP4", &_eepromData.profile.tcTable[4], 0, MAX_CALIB_DEGREES, 1, MENU_TC_POINT | 3},
+    {"SL1", (int16_t *)&_eepromData.sleepTimeout, 1, MAX_SLEEP_MINS, 1, 2},
+    {"SL2", (int16_t *)&_eepromData.deepSleepTimeout, 1, MAX_DEEPSLEEP_MINS, 1, MENU_AFTER_SLEEP | 2},
+    {"bSt", (int16_t *)&_eepromData.boostOnWake, 0, 1, 1, MENU_TOGGLE | 1},
+    {"FRC", (int16_t *)&_eepromData.forceModeIncrement, 0, MAX_FORCE_VAL, 1, 3},
+    {"GP", (int16_t *)&_eepromData.profile.pidGains.kp, 0, PID_MAX_GAIN, 1, 3},
+    {"GI", (int16_t *)&_eepromData.profile.pidGains.ki, 0, PID_MAX_GAIN, 1, 3},
+    {"Gd", (int16_t *)&_eepromData.profile.pidGains.kd, 0, PID_MAX_GAIN, 1, 3},
+    {"At", 0, 0, 0, 0, MENU_AUTOTUNE},
+};
+
+#define MENU_ITEMS ((int16_t)(sizeof(_menuItems) / sizeof(_menuItems[0])))
+
+static int16_t _menuIndex = 0;
+
+/* Applies the button steps to the item value and keeps it within its bounds
+    in: menu item, number of steps (negative to decrease)
+    out: none
+*/
+static void editItem(const struct MENU_ITEM *item, int8_t step)
+{
+    int16_t *value = item->value;
+    int16_t oldValue = *value;
+    int16_t lower = item->min;
+    int16_t upper = item->max;
+
+    if (item->flags & MENU_TOGGLE)
+    {
+        *value = step ? !*value : *value;
+    }
+    else
+    {
+        *value += step * item->step;
+    }
+    if (item->flags & MENU_TC_POINT)
+    {
+        // Keep the table monotonic, the ends follow the measured points
+        uint8_t point = value - _eepromData.profile.tcTable;
+        lower = (point > 1) ? value[-1] + 1 : lower;
+        upper = (point < TC_NUM_POINTS - 2) ? value[1] - 1 : upper;
+    }
+    if (item->flags & MENU_AFTER_SLEEP)
+    {
+        lower = _eepromData.sleepTimeout;
+    }
+    *value = (*value < lower) ? lower : (*value > upper) ? upper : *value;
+
+    if (oldValue != *value)
+    {
+        if (item->flags & MENU_TC_POINT)
+        {
+            TC_extrapolateEnds(_eepromData.profile.tcTable);
+            TC_init(_eepromData.profile.tcTable);
+        }
+        scheduleDataSave();
+    }
+}
+
+/* Renders the item value right aligned, with a minus sign when negative
+    in: menu item
+    out: none
+*/
+static void renderItem(const struct MENU_ITEM *item)
 {
-    int16_t menuIndex = 0;
-    _menuDisplayTime = currentMillis() + MENU_DISPLAY_DELAY;
+    int16_t value = *item->value;
+    uint8_t digits = item->flags & MENU_DIGITS;
+    for (uint8_t digit = 0; digit < 3 - digits; digit++)
+    {
+        S7C_setSymbol(digit, (digit == 0 && value < 0) ? MINUS_SYM : 0);
+    }
+    S7C_setNumber(3 - digits, digits, abs(value));
+}
 
-    while (1)
+/* AUTO-TUNE: any button starts the experiment at the heat point
+    in: number of steps, any non zero value starts the tuning
+    out: none
+*/
+static void autoTunePage(int8_t step)
+{
+    if (step)
+        setAutoTune(1);
+    const struct TUNE *tune = autoTuneState();
+    switch (tune->state)
     {
-        uint32_t nowTime = currentMillis();
-        uint8_t menuAction = checkDoubleClick(&_btnPlus, &menuIndex, 1, nowTime) ||
-                             checkDoubleClick(&_btnMinus, &menuIndex, -1, nowTime);
-        if (menuAction)
+    case TUNE_HEATING:
+        S7C_setChars("HEA");
+        break;
+    case TUNE_RELAY_CYCLES:
+        S7C_setChars("C");
+        S7C_setNumber(1, 2, tune->cycles);
+        break;
+    case TUNE_DONE:
+        S7C_setChars("End");
+        break;
+    case TUNE_FAILED:
+        S7C_setChars("Err");
+        break;
+    default:
+        S7C_setChars("---");
+    }
+}
+
+static void menuTask(uint32_t nowTime)
+{
+    // Double click walks through the pages, holding a button edits the value
+    struct BUTTON_EVENT event;
+    int8_t step = 0;
+    uint8_t menuAction = 0;
+    while (BUTTONS_getEvent(&event))
+    {
+        int8_t direction = (event.button == BTN_PLUS) ? 1 : (event.button == BTN_MINUS) ? -1 : 0;
+        if (event.type == BTN_DOUBLE_CLICK)
+        {
+            _menuIndex += direction;
+            menuAction = direction != 0;
+        }
+        else if (event.type == BTN_REPEAT)
         {
-            _menuDisplayTime = nowTime + MENU_DISPLAY_DELAY;
-            menuIndex = menuIndex > FORCE_VAL ? 0 : menuIndex < 0 ? FORCE_VAL : menuIndex;
+            step += direction;
+            if (event.count < BUTTON_FAST_REPEAT)
+                beep();
         }
+    }
+    if (menuAction)
+    {
+        step = 0;
+        TIMER_start(TIMER_MENU_DISPLAY, MENU_DISPLAY_DELAY, 0);
+        _menuIndex = _menuIndex >= MENU_ITEMS ? 0 : _menuIndex < 0 ? MENU_ITEMS - 1 : _menuIndex;
+    }
+    const struct MENU_ITEM *item = &_menuItems[_menuIndex];
+
+    // The heater is regulated only while a calibration or the auto-tune page is open
+    setCalibrationPoint((item->flags & MENU_TC_POINT) ? item->value - _eepromData.profile.tcTable : 0);
+    if (!(item->flags & MENU_AUTOTUNE))
+        setAutoTune(0);
 
-        if (nowTime < _menuDisplayTime)
+    if (TIMER_running(TIMER_MENU_DISPLAY))
+    {
+        S7C_setChars(item->name);
+    }
+    else
+    {
+        if (item->flags & MENU_AUTOTUNE)
         {
-            S7C_setChars(_menuNames[menuIndex]);
+            autoTunePage(step);
         }
         else
         {
-            uint16_t oldSoundValue = _eepromData.enableSound;
-            int16_t oldCalibrationValue = _eepromData.calibrationValue;
-            uint16_t oldSleepTimeout = _eepromData.sleepTimeout;
-            uint16_t oldDeepSleepTimeout = _eepromData.deepSleepTimeout;
-            uint16_t oldforceModeIncrement = _eepromData.forceModeIncrement;
-            switch (menuIndex)
-            {
-            case ENABLE_SOUND: // ENABLE SOUND: values 0 or 1
-                S7C_setSymbol(0, 0);
-                S7C_setSymbol(1, 0);
-                checkButton(&_btnPlus, &_eepromData.enableSound, 1, nowTime);  // ADD button
-                checkButton(&_btnMinus, &_eepromData.enableSound, 1, nowTime); // MINUS button
-                if (oldSoundValue != _eepromData.enableSound)
-                {
-                    _eepromData.enableSound = (_eepromData.enableSound > 1) ? 0 : _eepromData.enableSound;
-                    _haveToSaveData = nowTime;
-                }
-                S7C_setDigit(2, _eepromData.enableSound);
-                break;
-            case CALIBRATION_VAL: // CALIBRATION: values from -MAX_CALIB_VAL to MAX_CALIB_VAL
-                checkButton(&_btnPlus, &_eepromData.calibrationValue, 1, nowTime);
-                checkButton(&_btnMinus, &_eepromData.calibrationValue, -1, nowTime);
-                if (oldCalibrationValue != _eepromData.calibrationValue)
-                {
-                    _eepromData.calibrationValue = (_eepromData.calibrationValue < -MAX_CALIB_VAL) ? -MAX_CALIB_VAL : (_eepromData.calibrationValue > MAX_CALIB_VAL) ? MAX_CALIB_VAL : _eepromData.calibrationValue;
-                    _haveToSaveData = nowTime;
-                }
-                S7C_setSymbol(0, _eepromData.calibrationValue < 0 ? MINUS_SYM : 0);
-                S7C_setDigit(1, abs(_eepromData.calibrationValue / 10));
-                S7C_setDigit(2, abs(_eepromData.calibrationValue % 10));
-                break;
-            case SLEEP1_VAL: // SLEEP: values 1..MAX_SLEEP_MINS minutes
-                checkButton(&_btnPlus, &_eepromData.sleepTimeout, 1, nowTime);
-                checkButton(&_btnMinus, &_eepromData.sleepTimeout, -1, nowTime);
-                if (oldSleepTimeout != _eepromData.sleepTimeout)
-                {
-                    _eepromData.sleepTimeout = (_eepromData.sleepTimeout < 1) ? 1 : (_eepromData.sleepTimeout > MAX_SLEEP_MINS) ? MAX_SLEEP_MINS : _eepromData.sleepTimeout;
-                    _haveToSaveData = nowTime;
-                }
-                S7C_setSymbol(0, 0);
-                S7C_setDigit(1, _eepromData.sleepTimeout / 10);
-                S7C_setDigit(2, _eepromData.sleepTimeout % 10);
-                break;
-            case SLEEP2_VAL: // DEEP SLEEP: values SLEEP..MAX_DEEPSLEEP_MINS minutes
-                checkButton(&_btnPlus, &_eepromData.deepSleepTimeout, 1, nowTime);
-                checkButton(&_btnMinus, &_eepromData.deepSleepTimeout, -1, nowTime);
-                _eepromData.deepSleepTimeout = (_eepromData.deepSleepTimeout < _eepromData.sleepTimeout) ? _eepromData.sleepTimeout : (_eepromData.deepSleepTimeout > MAX_DEEPSLEEP_MINS) ? MAX_DEEPSLEEP_MINS : _eepromData.deepSleepTimeout;
-                if (oldDeepSleepTimeout != _eepromData.deepSleepTimeout)
-                {
-                    _haveToSaveData = nowTime;
-                }
-                S7C_setSymbol(0, 0);
-                S7C_setDigit(1, _eepromData.deepSleepTimeout / 10);
-                S7C_setDigit(2, _eepromData.deepSleepTimeout % 10);
-                break;
-            case FORCE_VAL: // FORCE MODE INCREMENT: values 0..100 degrees
-                checkButton(&_btnPlus, &_eepromData.forceModeIncrement, 1, nowTime);
-                checkButton(&_btnMinus, &_eepromData.forceModeIncrement, -1, nowTime);
-                _eepromData.forceModeIncrement = _eepromData.forceModeIncrement > MAX_FORCE_VAL ? MAX_FORCE_VAL : _eepromData.forceModeIncrement;
-                if (oldforceModeIncrement != _eepromData.forceModeIncrement)
-                {
-                    _haveToSaveData = nowTime;
-                }
-                S7C_setDigit(0, _eepromData.forceModeIncrement / 100);
-                S7C_setDigit(1, (_eepromData.forceModeIncrement / 10) % 10);
-                S7C_setDigit(2, _eepromData.forceModeIncrement % 10);
-                break;
-            default:
-                S7C_setChars("ERR");
-            }
-            S7C_setSymbol(3, 0);
+            editItem(item, step);
+            renderItem(item);
         }
-
-        checkPendingDataSave(nowTime);
-        S7C_refreshDisplay(nowTime);
-        delay_ms(1);
+        S7C_setSymbol(3, 0);
     }
 }
+
+//
+//  TODO:
+//
+void setup_menu()
+{
+    _menuIndex = 0;
+    TIMER_start(TIMER_MENU_DISPLAY, MENU_DISPLAY_DELAY, 0);
+    SCHED_addTask(menuTask, MENU_PERIOD);
+}
@@ -26,6 +26,9 @@
 #ifndef _MENU_H_
 #define _MENU_H_
 
+/*
+ *  Register the Service Menu task in place of the normal working tasks
+ */
 void setup_menu();
 
 #endif //_MENU_H_
@@ -0,0 +1,71 @@
+//
+//  pid.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <pid.h>
+
+void PID_defaultGains(struct PID_GAINS *gains)
+{
+    gains->kp = PID_DEFAULT_KP;
+    gains->ki = PID_DEFAULT_KI;
+    gains->kd = PID_DEFAULT_KD;
+}
+
+void PID_init(struct PID *pid, int16_t outMin, int16_t outMax)
+{
+    pid->outMin = ((int32_t)outMin << PID_SHIFT) / PID_OUT_SCALE;
+    pid->outMax = ((int32_t)outMax << PID_SHIFT) / PID_OUT_SCALE;
+    PID_reset(pid, 0);
+}
+
+void PID_reset(struct PID *pid, int16_t input)
+{
+    pid->integral = 0;
+    pid->lastInput = input;
+}
+
+int16_t PID_compute(struct PID *pid, const struct PID_GAINS *gains, int16_t setPoint, int16_t input)
+{
+    int32_t outMin = pid->outMin;
+    int32_t outMax = pid->outMax;
+
+    int16_t error = setPoint - input;
+    int16_t dInput = input - pid->lastInput;
+    pid->lastInput = input;
+
+    // Anti-windup: integral alone never exceeds the output range
+    pid->integral += (int32_t)gains->ki * error;
+    if (pid->integral > outMax)
+        pid->integral = outMax;
+    else if (pid->integral < outMin)
+        pid->integral = outMin;
+
+    // Derivative on measurement, no kick on set-point change
+    int32_t out = (int32_t)gains->kp * error + pid->integral - (int32_t)gains->kd * dInput;
+    if (out > outMax)
+        out = outMax;
+    else if (out < outMin)
+        out = outMin;
+
+    // The Q6 fraction gives the per-mille digit
+    return (int16_t)((out * PID_OUT_SCALE) >> PID_SHIFT);
+}
@@ -0,0 +1,77 @@
+//
+//  pid.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef _PID_H_
+#define _PID_H_
+
+#include <stdint.h>
+
+// Gains are Q6 fixed point: a value of 64 is a gain of 1.0
+#define PID_SHIFT 6
+
+// Gains are in percents of the output range, the output is in per-mille
+#define PID_OUT_SCALE 10
+
+#define PID_DEFAULT_KP 192 // 3.0 % of power per degree
+#define PID_DEFAULT_KI 4   // 0.0625 % per degree per PID period
+#define PID_DEFAULT_KD 320 // 5.0 % per degree of change per PID period
+#define PID_MAX_GAIN 999   // three digits in the menu
+
+struct PID_GAINS
+{
+    uint16_t kp;
+    uint16_t ki;
+    uint16_t kd;
+};
+
+struct PID
+{
+    int32_t integral; // Q6 percents
+    int32_t outMin;   // Q6 percents
+    int32_t outMax;
+    int16_t lastInput;
+};
+
+/*
+ *  Fill in the factory gains
+ */
+void PID_defaultGains(struct PID_GAINS *gains);
+
+/*
+ *  Initialize the regulator state
+ *  in: output range, per-mille
+ */
+void PID_init(struct PID *pid, int16_t outMin, int16_t outMax);
+
+/*
+ *  Drop the accumulated state, start from the given measurement
+ */
+void PID_reset(struct PID *pid, int16_t input);
+
+/*
+ *  Compute a new output in per-mille, must be called at a fixed rate
+ *  Derivative is taken on measurement, integral is clamped to the output range
+ */
+int16_t PID_compute(struct PID *pid, const struct PID_GAINS *gains, int16_t setPoint, int16_t input);
+
+#endif //_PID_H_
@@ -0,0 +1,76 @@
+//
+//  power.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <stm8s.h>
+#include <stm8s_pins.h>
+#include <power.h>
+#include <watchdog.h>
+
+// AWU period 2^10 * APRDIV / fLSI = 1024 * 62 / 128 kHz, about 0.5 s,
+// the watchdog keeps running while halted and is refreshed on every wake-up
+#define AWU_TIMEBASE 0x0B
+#define AWU_APRDIV 62
+
+void AWU_interrupt_handler() __interrupt(AWU_ISR)
+{
+    // Reading the status register clears AWUF
+    uint8_t csr = AWU_CSR;
+    (void)csr;
+}
+
+void POWER_deepSleep(uint8_t (*checkWakeUp)())
+{
+    disable_interrupts();
+    uint8_t pckenr1 = CLK_PCKENR1;
+    uint8_t pckenr2 = CLK_PCKENR2;
+
+    // Only the AWU keeps its clock, TIM4 stops so the display stays blank
+    CLK_PCKENR1 = 0;
+    CLK_PCKENR2 = (1 << CLK_PCKENR2_AWU);
+
+    // Periodic wake-up from the low speed oscillator
+    CLK_ICKR |= (1 << CLK_ICKR_LSIEN);
+    AWU_TBR = AWU_TIMEBASE;
+    AWU_APR = AWU_APRDIV;
+    AWU_CSR = (1 << AWU_CSR_AWUEN);
+
+    // Flash in power-down and the main regulator off while halted
+    FLASH_CR1 |= (1 << FLASH_CR1_AHALT);
+    CLK_ICKR |= (1 << CLK_ICKR_REGAH);
+
+    // The port B external interrupt of the buttons wakes us up as well
+    do
+    {
+        halt(); // enables the interrupts, returns after the wake-up ISR
+        WATCHDOG_refresh();
+    } while (!checkWakeUp());
+
+    disable_interrupts();
+    AWU_CSR = 0;
+    AWU_TBR = 0;
+    FLASH_CR1 &= ~(1 << FLASH_CR1_AHALT);
+    CLK_ICKR &= ~(1 << CLK_ICKR_REGAH);
+    CLK_PCKENR1 = pckenr1;
+    CLK_PCKENR2 = pckenr2;
+    enable_interrupts();
+}
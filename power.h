@@ -0,0 +1,41 @@
+//
+//  power.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef _POWER_H_
+#define _POWER_H_
+
+#include <stm8s.h>
+
+void AWU_interrupt_handler() __interrupt(AWU_ISR);
+
+/*
+ *  Active-halt with all peripheral clocks gated except the AWU
+ *  in: a check run on every wake-up, periodic AWU or an enabled
+ *      external interrupt, the sleep ends when it returns non-zero
+ *  The caller has to leave the outputs in a safe state and must
+ *  disable the interrupts before the last output is written, the
+ *  core halts with the peripherals stopped so nothing changes any more
+ */
+void POWER_deepSleep(uint8_t (*checkWakeUp)());
+
+#endif // _POWER_H_
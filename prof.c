@@ -0,0 +1,144 @@
+//
+//  prof.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <stm8s.h>
+#include <prof.h>
+
+#if PROFILING
+
+#include <telemetry.h>
+#include <stack.h>
+
+struct Stat
+{
+    uint16_t start;
+    uint16_t min;
+    uint16_t max;
+    uint16_t count;
+    uint32_t sum;
+};
+
+static struct Stat _stats[PROF_NUM_SECTIONS];
+static uint8_t _marked = 0; // one bit per section
+
+static void resetStats()
+{
+    for (uint8_t i = 0; i < PROF_NUM_SECTIONS; i++)
+    {
+        _stats[i].min = 0xFFFF;
+        _stats[i].max = 0;
+        _stats[i].count = 0;
+        _stats[i].sum = 0;
+    }
+}
+
+// The high byte has to be read first, it latches the low byte
+static uint16_t counterISR()
+{
+    uint8_t h = TIM1_CNTRH;
+    return (h << 8) | TIM1_CNTRL;
+}
+
+static uint16_t counter()
+{
+    disable_interrupts();
+    uint16_t cnt = counterISR();
+    enable_interrupts();
+    return cnt;
+}
+
+static void record(uint8_t section, uint16_t cycles)
+{
+    struct Stat *stat = &_stats[section];
+    if (cycles < stat->min)
+        stat->min = cycles;
+    if (cycles > stat->max)
+        stat->max = cycles;
+    if (stat->count < 0xFFFF)
+    {
+        stat->count++;
+        stat->sum += cycles;
+    }
+}
+
+void PROF_init()
+{
+    resetStats();
+    // Same time base as SOUND_init, the tone edges are compares on it
+    TIM1_PSCRH = 0; // count every CPU cycle
+    TIM1_PSCRL = 0;
+    TIM1_ARRH = 0xFF;
+    TIM1_ARRL = 0xFF;
+    TIM1_EGR = 0x01; // load the prescaler
+    TIM1_CR1 = 0x01; // enable
+}
+
+void PROF_begin(uint8_t section)
+{
+    _stats[section].start = counter();
+}
+
+void PROF_end(uint8_t section)
+{
+    record(section, counter() - _stats[section].start);
+}
+
+void PROF_beginISR(uint8_t section)
+{
+    _stats[section].start = counterISR();
+}
+
+void PROF_endISR(uint8_t section)
+{
+    record(section, counterISR() - _stats[section].start);
+}
+
+void PROF_mark(uint8_t section)
+{
+    uint16_t now = counter();
+    if (_marked & (1 << section)) // the first mark only starts the measure
+        record(section, now - _stats[section].start);
+    _marked |= (1 << section);
+    _stats[section].start = now;
+}
+
+void PROF_report(uint32_t nowTime)
+{
+    static struct PROF_FRAME frame;
+    disable_interrupts(); // the ISR sections are updated from TIM4
+    for (uint8_t i = 0; i < PROF_NUM_SECTIONS; i++)
+    {
+        struct Stat *stat = &_stats[i];
+        frame.sections[i].min = stat->count ? stat->min : 0;
+        frame.sections[i].max = stat->max;
+        frame.sections[i].avg = stat->count ? stat->sum / stat->count : 0;
+    }
+    resetStats();
+    enable_interrupts();
+    frame.reserved = 0;
+    frame.stack.highWater = STACK_highWater();
+    frame.stack.headroom = STACK_headroom();
+    TELEMETRY_sendFrame((uint8_t *)&frame, sizeof(frame.stack) + sizeof(frame.sections) + 1);
+}
+
+#endif // PROFILING
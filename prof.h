@@ -0,0 +1,112 @@
+//
+//  prof.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef _PROF_H_
+#define _PROF_H_
+
+#include <stdint.h>
+
+// Build with PROFILING=1 to measure the hot paths, everything compiles
+// out otherwise. TIM1 counts CPU cycles (62.5 ns at 16 MHz) and wraps
+// every 4.096 ms, longer sections are not measured correctly.
+#ifndef PROFILING
+#define PROFILING 0
+#endif
+
+#define PROF_PERIOD 1000 // ms, report and restart the statistics
+
+enum PROF_SECTIONS
+{
+    PROF_SENSORS,
+    PROF_BUTTONS,
+    PROF_CONTROL,
+    PROF_DISPLAY,
+    PROF_REFRESH, // display multiplexing, in the TIM4 interrupt
+    PROF_TICK,    // scheduler pass to pass, max - min is the loop jitter
+    PROF_NUM_SECTIONS
+};
+
+#if PROFILING
+
+struct PROF_FRAME
+{
+    uint8_t sync1;
+    uint8_t sync2;
+    uint8_t length;
+    uint8_t reserved;
+    struct
+    {
+        uint16_t highWater; // deepest use since the startup paint
+        uint16_t headroom;  // bytes the stack never reached
+    } stack;
+    struct
+    {
+        uint16_t min;
+        uint16_t avg;
+        uint16_t max;
+    } sections[PROF_NUM_SECTIONS]; // cycles
+    uint8_t checksum;
+};
+
+/*
+ *  Start TIM1 as a free running cycle counter
+ */
+void PROF_init();
+
+/*
+ *  Section boundaries, the _ISR variants must be used in interrupt
+ *  handlers, the others briefly disable the interrupts to read TIM1
+ */
+void PROF_begin(uint8_t section);
+void PROF_end(uint8_t section);
+void PROF_beginISR(uint8_t section);
+void PROF_endISR(uint8_t section);
+
+/*
+ *  Measure the time since the previous mark of the section
+ */
+void PROF_mark(uint8_t section);
+
+/*
+ *  Send the statistics and the stack high-water mark with the telemetry
+ *  and start over, a scheduler task
+ */
+void PROF_report(uint32_t nowTime);
+
+#define PROF_START(section) PROF_begin(section)
+#define PROF_STOP(section) PROF_end(section)
+#define PROF_START_ISR(section) PROF_beginISR(section)
+#define PROF_STOP_ISR(section) PROF_endISR(section)
+#define PROF_MARK(section) PROF_mark(section)
+
+#else
+
+#define PROF_START(section)
+#define PROF_STOP(section)
+#define PROF_START_ISR(section)
+#define PROF_STOP_ISR(section)
+#define PROF_MARK(section)
+
+#endif // PROFILING
+
+#endif //_PROF_H_
@@ -26,16 +26,26 @@
 #include <stm8s.h>
 #include <pwm.h>
 
+#ifndef F_CPU
+#warning "F_CPU not defined, using 16MHz by default"
+#define F_CPU 16000000UL
+#endif
+
+static uint16_t _period = PWM_PERIOD;
+static uint16_t _maxCounts = PWM_PERIOD; // end of the low part, the OFF window follows
+static uint16_t _samplePoint = PWM_PERIOD - 1;
+
 /******************************************************************************
  *
  *  Initialize PWM
- *  in: mode, channels to use
+ *  in: channels to use, prescaler, period
  * 
  * To generate the PWM signals the TIM2 peripheral must be configured as follows:
  *  ● Output state enabled for each channel
- *  ● Output compare active low for each channel
+ *  ● PWM mode 2 for each channel: the output is low until the counter reaches CCRx,
+ *    high until the end of the period, so the last part of the period is the OFF window
  *  ● Preload register enabled for each channel
- *  ● PWM output signal frequency = 125 Hz:
+ *  ● PWM output signal frequency = 125 Hz by default (PWM_PRESCALER, PWM_PERIOD):
  *      – The timer source clock frequency is 16 MHz (fCPU by default) and the prescaler is
  *        set to 7 to obtain a TIM2 counter clock of 125 kHz  (16000000 / 2^7 = 125000)
  *      – PWM output signal frequency can be set according to the following equation:
@@ -55,31 +65,39 @@
  * 
  */
 
-void PWM_init(uint8_t ch)
+void PWM_init(uint8_t ch, uint8_t prescaler, uint16_t period)
 {
-    TIM2_PSCR = 7;       /* 16000000 / (2^7 * (1 + 999)) = 125 Hz */
-    int _TIM2_ARR = 999; /* 125 Hz */
+    // The OFF window and the sample point are times, convert them to counts
+    uint16_t countsPerMs = (uint16_t)((F_CPU / 1000) >> prescaler);
+    uint16_t window = (uint16_t)(((uint32_t)countsPerMs * PWM_OFF_WINDOW_US + 999) / 1000);
+    uint16_t lead = (uint16_t)(((uint32_t)countsPerMs * PWM_SAMPLE_LEAD_US + 999) / 1000);
+    _period = period;
+    _maxCounts = (window < period) ? period - window : 0;
+    _samplePoint = (lead < period) ? period - lead : 0;
+
+    TIM2_PSCR = prescaler;       /* 16000000 / (2^7 * (1 + 999)) = 125 Hz */
+    uint16_t _TIM2_ARR = period - 1;
     TIM2_ARRH = (_TIM2_ARR >> 8) & 0xff;
     TIM2_ARRL = _TIM2_ARR & 0xff;
     if (ch & PWM_CH1)
     {
-        TIM2_CCR1H = 0;
+        TIM2_CCR1H = 0; /* output high from the start */
         TIM2_CCR1L = 0;
-        TIM2_CCMR1 = 0x68;  /* PWM mode 1, use preload register */
+        TIM2_CCMR1 = 0x78;  /* PWM mode 2, use preload register */
         TIM2_CCER1 |= 0x01; /* output enable, normal polarity */
     }
     if (ch & PWM_CH2)
     {
         TIM2_CCR2H = 0;
         TIM2_CCR2L = 0;
-        TIM2_CCMR2 = 0x68;
+        TIM2_CCMR2 = 0x78;
         TIM2_CCER1 |= 0x10;
     }
     if (ch & PWM_CH3)
     {
         TIM2_CCR3H = 0;
         TIM2_CCR3L = 0;
-        TIM2_CCMR3 = 0x68;
+        TIM2_CCMR3 = 0x78;
         TIM2_CCER2 |= 0x01;
     }
     TIM2_CR1 = 0x81; /* use TIM2_ARR preload register, enable */
@@ -88,12 +106,25 @@ void PWM_init(uint8_t ch)
 /******************************************************************************
  *
  *  Set duty count
- *  in: channel(s), new duty count (times 1/2 microsecond)
+ *  in: channel(s), percentage of the period the output is high
  */
 
 void PWM_duty(uint8_t ch, uint16_t duty)
 {
-    duty = duty * 10;
+    // mode 2: the output goes high at CCR
+    PWM_dutyRaw(ch, (duty > 100) ? PWM_RAW_OFF : (uint16_t)((uint32_t)_period * (100 - duty) / 100));
+}
+
+/******************************************************************************
+ *
+ *  Set compare count
+ *  in: channel(s), counts the output is low
+ */
+
+void PWM_dutyRaw(uint8_t ch, uint16_t duty)
+{
+    // keep the OFF window at the end
+    duty = (duty > _maxCounts) ? _maxCounts : duty;
     uint8_t dH, dL;
 
     dH = (duty >> 8) & 0xff;
@@ -115,3 +146,66 @@ void PWM_duty(uint8_t ch, uint16_t duty)
         TIM2_CCR3L = dL;
     }
 }
+
+/******************************************************************************
+ *
+ *  Force the reference high (mode 2 output high), the compare value is not
+ *  touched and the preload is bypassed, the change is immediate
+ *  in: channel(s)
+ */
+
+void PWM_forceOff(uint8_t ch)
+{
+    if (ch & PWM_CH1)
+        TIM2_CCMR1 = 0x58; /* force active level, use preload register */
+    if (ch & PWM_CH2)
+        TIM2_CCMR2 = 0x58;
+    if (ch & PWM_CH3)
+        TIM2_CCMR3 = 0x58;
+}
+
+void PWM_release(uint8_t ch)
+{
+    if (ch & PWM_CH1)
+        TIM2_CCMR1 = 0x78; /* PWM mode 2, use preload register */
+    if (ch & PWM_CH2)
+        TIM2_CCMR2 = 0x78;
+    if (ch & PWM_CH3)
+        TIM2_CCMR3 = 0x78;
+}
+
+uint16_t PWM_period()
+{
+    return _period;
+}
+
+uint16_t PWM_samplePoint()
+{
+    return _samplePoint;
+}
+
+/******************************************************************************
+ *
+ *  Disable/enable the channel outputs
+ *  in: channel(s)
+ */
+
+void PWM_stop(uint8_t ch)
+{
+    if (ch & PWM_CH1)
+        TIM2_CCER1 &= ~0x01;
+    if (ch & PWM_CH2)
+        TIM2_CCER1 &= ~0x10;
+    if (ch & PWM_CH3)
+        TIM2_CCER2 &= ~0x01;
+}
+
+void PWM_start(uint8_t ch)
+{
+    if (ch & PWM_CH1)
+        TIM2_CCER1 |= 0x01;
+    if (ch & PWM_CH2)
+        TIM2_CCER1 |= 0x10;
+    if (ch & PWM_CH3)
+        TIM2_CCER2 |= 0x01;
+}
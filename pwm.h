@@ -28,17 +28,68 @@
 
 #include <stdint.h>
 
-void PWM_init(uint8_t);
-
 #define PWM_CH1 (1 << 0)
-#define PWM_CH2 (1 << 1)
+#define PWM_CH2 (1 << 1) // TIM2 channel 2 is the ADC trigger, see ADC_startOnTimer
 #define PWM_CH3 (1 << 2)
 
+// Default timer setup: 16 MHz / 2^7 = 125 kHz counter, 1000 counts = 125 Hz
+#define PWM_PRESCALER 7
+#define PWM_PERIOD 1000
+
+// The output is low at the start and high at the end of the period,
+// it stays high for at least PWM_OFF_WINDOW_US: the heater is OFF there
+// and the thermocouple is sampled PWM_SAMPLE_LEAD_US before the period ends
+#define PWM_OFF_WINDOW_US 400
+#define PWM_SAMPLE_LEAD_US 80
+
+// Raw duty that keeps the output high for the whole period
+#define PWM_RAW_OFF 0
+
+/*
+ *  Initialize PWM
+ *  in: channels to use, TIM2 prescaler (counter clock F_CPU / 2^prescaler)
+ *      and period in counter clocks, the outputs start high
+ */
+
+void PWM_init(uint8_t ch, uint8_t prescaler, uint16_t period);
+
 /*
  *  Set new PWM duty cycle
- *  in: channel(s), percentage/2: 0 to 200
+ *  in: channel(s), percentage of the period the output is high,
+ *      at least the OFF window
  */
 
 void PWM_duty(uint8_t ch, uint16_t duty);
 
+/*
+ *  Set new PWM duty cycle in counter clocks, the compare value itself
+ *  in: channel(s), counts the output is low at the start of the period,
+ *      clamped to leave the OFF window, PWM_RAW_OFF keeps it high
+ */
+
+void PWM_dutyRaw(uint8_t ch, uint16_t counts);
+
+/*
+ *  Force the output(s) high at once, in the middle of a period, safe to
+ *  call from an interrupt; PWM_release() goes back to the PWM waveform
+ */
+
+void PWM_forceOff(uint8_t ch);
+void PWM_release(uint8_t ch);
+
+/*
+ *  Timer values of the current setup, in counter clocks
+ */
+
+uint16_t PWM_period();
+uint16_t PWM_samplePoint(); // in the OFF window, see ADC_startOnTimer
+
+/*
+ *  Disconnect the channel(s) from the pin, which then follows its GPIO
+ *  output register, and connect them back
+ */
+
+void PWM_stop(uint8_t ch);
+void PWM_start(uint8_t ch);
+
 #endif /* _PWM_H_ */
\ No newline at end of file
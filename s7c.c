@@ -23,36 +23,17 @@
 //  THE SOFTWARE.
 //
 
-#include <s7c.h>
+#include <stm8s.h>
 #include <stm8s_pins.h>
-#include <delay.h>
+#include <s7c.h>
 
 #define BLANK_IDX 36 // Must match with 'digitCodeMap'
 #define DASH_IDX 37
 #define PERIOD_IDX 38
 #define ASTERISK_IDX 39
 
-static const long powersOf10[] = {
-    1, // 10^0
-    10,
-    100,
-    1000,
-    10000,
-    100000,
-    1000000,
-    10000000,
-    100000000,
-    1000000000}; // 10^9
-
-static const long powersOf16[] = {
-    0x1, // 16^0
-    0x10,
-    0x100,
-    0x1000,
-    0x10000,
-    0x100000,
-    0x1000000,
-    0x10000000}; // 16^7
+// Decades for the subtract-based conversion of S7C_setNumber
+static const uint16_t decades[] = {10000, 1000, 100, 10, 1};
 
 // digitCodeMap indicate which segments must be illuminated to display
 // each number.
@@ -104,325 +85,102 @@ static const uint8_t digitCodeMap[] = {
 const uint8_t *const numeralCodes = digitCodeMap;
 const uint8_t *const alphaCodes = digitCodeMap + 10;
 
-// SevSeg Constructor
-/******************************************************************************/
+// Pin masks of the segments, per port. The port is named by any of its pins
+#define SEG_MASK(pin, port) ((((pin) >> 3) == ((port) >> 3)) ? (1 << BIT(pin)) : 0)
+#define SEG_MASKS(port) {SEG_MASK(S7C_SEG_A, port), SEG_MASK(S7C_SEG_B, port), SEG_MASK(S7C_SEG_C, port), \
+                         SEG_MASK(S7C_SEG_D, port), SEG_MASK(S7C_SEG_E, port), SEG_MASK(S7C_SEG_F, port), \
+                         SEG_MASK(S7C_SEG_G, port)}
+#define SEG_PINS(port) (SEG_MASK(S7C_SEG_A, port) | SEG_MASK(S7C_SEG_B, port) | SEG_MASK(S7C_SEG_C, port) | \
+                        SEG_MASK(S7C_SEG_D, port) | SEG_MASK(S7C_SEG_E, port) | SEG_MASK(S7C_SEG_F, port) | \
+                        SEG_MASK(S7C_SEG_G, port))
 
-static uint8_t digitOnVal, digitOffVal, segmentOnVal, segmentOffVal;
-static uint8_t resOnSegments = 0, updateWithDelays = 0, leadingZeros;
-static uint8_t digitPins[MAXNUMDIGITS];
-static uint8_t segmentPins[8];
-static uint8_t numDigits = 4;
-static uint8_t numSegments;
-static uint8_t prevUpdateIdx = 0;        // The previously updated segment or digit
-static uint8_t digitCodes[MAXNUMDIGITS]; // The active setting of each segment of each digit
-static uint32_t prevUpdateTime = 0;      // The time (millis()) when the display was last updated
-static int ledOnTime = 10;               // The time (us) to wait with LEDs on
-static int waitOffTime = 0;              // The time (us) to wait with LEDs off
-static uint8_t waitOffActive = 0;        // Whether  the program is waiting with LEDs off
+static const uint8_t segmentPinsC[S7C_NUM_SEGMENTS] = SEG_MASKS(PC0);
+static const uint8_t segmentPinsE[S7C_NUM_SEGMENTS] = SEG_MASKS(PE0);
 
-void S7C_init()
-{
-  uint8_t numDigits = 4;
-  uint8_t digitPins[] = {PD0, PD1, PD2, PD3};
-  uint8_t segmentPins[] = {PC7, PC5, PC3, PE5, PC2, PC6, PC1, PC4};
-  uint8_t resistorsOnSegments = false;   // 'false' means resistors are on digit pins
-  uint8_t hardwareConfig = COMMON_ANODE; // See README.md for options
-  uint8_t updateWithDelays = true;       // Default. Recommended
-  uint8_t leadingZeros = false;          // Use 'true' if you'd like to keep the leading zeros
-  S7C_begin(hardwareConfig, numDigits, digitPins, segmentPins, resistorsOnSegments, updateWithDelays, leadingZeros, 1);
-}
+static uint8_t digitCodes[S7C_NUM_DIGITS]; // The active setting of each segment of each digit
+static uint8_t dirtyDigits = 0xFF;         // Digits changed behind the back of S7C_setNumber
+static volatile uint8_t dimming = S7C_DIM_OFF; // Dark steps after each lit segment
 
-// begin
+// allOff
 /******************************************************************************/
-// Saves the input pin numbers to the class and sets up the pins to be used.
-// If you use current-limiting resistors on your segment pins instead of the
-// digit pins, then set resOnSegments as true.
-// Set updateWithDelays to true if you want to use the 'pre-2017' update method
-// In that case, the processor is occupied with delay functions while refreshing
-// leadingZerosIn indicates whether leading zeros should be displayed
-// disableDecPoint is true when the decimal point segment is not connected, in
-// which case there are only 7 segments.
-void S7C_begin(uint8_t hardwareConfig, uint8_t numDigitsIn, uint8_t digitPinsIn[],
-               uint8_t segmentPinsIn[], uint8_t resOnSegmentsIn,
-               uint8_t updateWithDelaysIn, uint8_t leadingZerosIn, uint8_t disableDecPoint)
+// Switches all the digits off and releases all the segments
+static void allOff()
 {
-
-  resOnSegments = resOnSegmentsIn;
-  updateWithDelays = updateWithDelaysIn;
-  leadingZeros = leadingZerosIn;
-
-  numDigits = numDigitsIn;
-  numSegments = disableDecPoint ? 7 : 8; // Ternary 'if' statement
-  //Limit the max number of digits to prevent overflowing
-  if (numDigits > MAXNUMDIGITS)
-    numDigits = MAXNUMDIGITS;
-
-  switch (hardwareConfig)
-  {
-
-  case 0: // Common cathode
-    digitOnVal = LOW;
-    segmentOnVal = HIGH;
-    break;
-
-  case 1: // Common anode
-    digitOnVal = HIGH;
-    segmentOnVal = LOW;
-    break;
-
-  case 2: // With active-high, low-side switches (most commonly N-type FETs)
-    digitOnVal = HIGH;
-    segmentOnVal = HIGH;
-    break;
-
-  case 3: // With active low, high side switches (most commonly P-type FETs)
-    digitOnVal = LOW;
-    segmentOnVal = LOW;
-    break;
-  }
-
-  digitOffVal = !digitOnVal;
-  segmentOffVal = !segmentOnVal;
-
-  // Save the input pin numbers to library variables
-  for (uint8_t segmentNum = 0; segmentNum < numSegments; segmentNum++)
-  {
-    segmentPins[segmentNum] = segmentPinsIn[segmentNum];
-  }
-
-  for (uint8_t digitNum = 0; digitNum < numDigits; digitNum++)
-  {
-    digitPins[digitNum] = digitPinsIn[digitNum];
-  }
-
-  // Set the pins as outputs, and turn them off
-  for (uint8_t digit = 0; digit < numDigits; digit++)
-  {
-    pinMode(digitPins[digit], OUTPUT);
-    setPin(digitPins[digit], digitOffVal);
-  }
-
-  for (uint8_t segmentNum = 0; segmentNum < numSegments; segmentNum++)
-  {
-    pinMode(segmentPins[segmentNum], OUTPUT);
-    setPin(segmentPins[segmentNum], segmentOffVal);
-  }
-
-  S7C_blank(); // Initialise the display
+  S7C_DIGIT_ODR &= ~S7C_DIGIT_PINS;
+  PC_ODR |= SEG_PINS(PC0);
+  PE_ODR |= SEG_PINS(PE0);
 }
 
-// refreshDisplay
-/******************************************************************************/
-// Turns on the segments specified in 'digitCodes[]'
-// There are 4 versions of this function, with the choice depending on the
-// location of the current-limiting resistors, and whether or not you wish to
-// use 'update delays' (the standard method until 2017).
-// For resistors on *digits* we will cycle through all 8 segments (7 + period),
-//    turning on the *digits* as appropriate for a given segment, before moving on
-//    to the next segment.
-// For resistors on *segments* we will cycle through all __ # of digits,
-//    turning on the *segments* as appropriate for a given digit, before moving on
-//    to the next digit.
-// If using update delays, refreshDisplay has a delay between each digit/segment
-//    as it cycles through. It exits with all LEDs off.
-// If not using updateDelays, refreshDisplay exits with a single digit/segment
-//    on. It will move to the next digit/segment after being called again (if
-//    enough time has passed).
-
-void S7C_refreshDisplay(uint32_t us)
+void S7C_init()
 {
-
-  if (!updateWithDelays)
-  {
-    // Exit if it's not time for the next display change
-    if (waitOffActive)
-    {
-      if (us - prevUpdateTime < waitOffTime)
-        return;
-    }
-    else
-    {
-      if (us - prevUpdateTime < ledOnTime)
-        return;
-    }
-    prevUpdateTime = us;
-
-    if (!resOnSegments)
-    {
-      /**********************************************/
-      // RESISTORS ON DIGITS, UPDATE WITHOUT DELAYS
-
-      if (waitOffActive)
-      {
-        waitOffActive = false;
-      }
-      else
-      {
-        // Turn all lights off for the previous segment
-        S7C_segmentOff(prevUpdateIdx);
-
-        if (waitOffTime)
-        {
-          // Wait a delay with all lights off
-          waitOffActive = true;
-          return;
-        }
-      }
-
-      prevUpdateIdx++;
-      if (prevUpdateIdx >= numSegments)
-        prevUpdateIdx = 0;
-
-      // Illuminate the required digits for the new segment
-      S7C_segmentOn(prevUpdateIdx);
-    }
-    else
-    {
-      /**********************************************/
-      // RESISTORS ON SEGMENTS, UPDATE WITHOUT DELAYS
-
-      if (waitOffActive)
-      {
-        waitOffActive = false;
-      }
-      else
-      {
-        // Turn all lights off for the previous digit
-        S7C_digitOff(prevUpdateIdx);
-
-        if (waitOffTime)
-        {
-          // Wait a delay with all lights off
-          waitOffActive = true;
-          return;
-        }
-      }
-
-      prevUpdateIdx++;
-      if (prevUpdateIdx >= numDigits)
-        prevUpdateIdx = 0;
-
-      // Illuminate the required segments for the new digit
-      S7C_digitOn(prevUpdateIdx);
-    }
-  }
-
-  else
+  static const uint8_t pins[] = {PD0, PD1, PD2, PD3, S7C_SEG_A, S7C_SEG_B, S7C_SEG_C,
+                                 S7C_SEG_D, S7C_SEG_E, S7C_SEG_F, S7C_SEG_G};
+  allOff();
+  for (uint8_t pin = 0; pin < sizeof(pins); pin++)
   {
-    if (!resOnSegments)
-    {
-      /**********************************************/
-      // RESISTORS ON DIGITS, UPDATE WITH DELAYS
-      for (uint8_t segmentNum = 0; segmentNum < numSegments; segmentNum++)
-      {
-
-        // Illuminate the required digits for this segment
-        S7C_segmentOn(segmentNum);
-
-        // Wait with lights on (to increase brightness)
-        delayMicroseconds(ledOnTime);
-
-        // Turn all lights off
-        S7C_segmentOff(segmentNum);
-
-        // Wait with all lights off if required
-        if (waitOffTime)
-          delayMicroseconds(waitOffTime);
-      }
-    }
-    else
-    {
-      /**********************************************/
-      // RESISTORS ON SEGMENTS, UPDATE WITH DELAYS
-      for (uint8_t digitNum = 0; digitNum < numDigits; digitNum++)
-      {
-
-        // Illuminate the required segments for this digit
-        S7C_digitOn(digitNum);
-
-        // Wait with lights on (to increase brightness)
-        delayMicroseconds(ledOnTime);
-
-        // Turn all lights off
-        S7C_digitOff(digitNum);
-
-        // Wait with all lights off if required
-        if (waitOffTime)
-          delayMicroseconds(waitOffTime);
-      }
-    }
+    pinMode(pins[pin], OUTPUT);
   }
+  S7C_blank(); // Initialise the display
 }
 
-// segmentOn
+// refreshStep
 /******************************************************************************/
-// Turns a segment on, as well as all corresponding digit pins
-// (according to digitCodes[])
-void S7C_segmentOn(uint8_t segmentNum)
+// Moves to the next segment of the multiplexing cycle. Called at a constant
+// rate from the timer interrupt, so every segment gets the same on-time
+// whatever the foreground code is doing. The digits are switched off first
+// and on last, so nothing ghosts while the segment pins change. When dimmed,
+// the display stays dark for a few steps after each lit segment.
+void S7C_refreshStep()
 {
-  setPin(segmentPins[segmentNum], segmentOnVal);
-  for (uint8_t digitNum = 0; digitNum < numDigits; digitNum++)
-  {
-    if (digitCodes[digitNum] & (1 << segmentNum))
-    { // Check a single bit
-      setPin(digitPins[digitNum], digitOnVal);
-    }
-  }
-}
+  static uint8_t segment = 0;
+  static uint8_t darkSteps = 0; // Left before the next segment is lit
 
-// segmentOff
-/******************************************************************************/
-// Turns a segment off, as well as all digit pins
-void S7C_segmentOff(uint8_t segmentNum)
-{
-  for (uint8_t digitNum = 0; digitNum < numDigits; digitNum++)
+  if (darkSteps)
   {
-    setPin(digitPins[digitNum], digitOffVal);
+    S7C_DIGIT_ODR &= ~S7C_DIGIT_PINS;
+    darkSteps--;
+    return;
   }
-  setPin(segmentPins[segmentNum], segmentOffVal);
-}
+  darkSteps = dimming;
 
-// digitOn
-/******************************************************************************/
-// Turns a digit on, as well as all corresponding segment pins
-// (according to digitCodes[])
-void S7C_digitOn(uint8_t digitNum)
-{
-  setPin(digitPins[digitNum], digitOnVal);
-  for (uint8_t segmentNum = 0; segmentNum < numSegments; segmentNum++)
+  if (++segment >= S7C_NUM_SEGMENTS)
+    segment = 0;
+  uint8_t mask = 1 << segment;
+  uint8_t digits = 0;
+  for (uint8_t digitNum = 0; digitNum < S7C_NUM_DIGITS; digitNum++)
   {
-    if (digitCodes[digitNum] & (1 << segmentNum))
-    { // Check a single bit
-      setPin(segmentPins[segmentNum], segmentOnVal);
-    }
+    digits |= (digitCodes[digitNum] & mask) ? (1 << digitNum) : 0;
   }
+
+  S7C_DIGIT_ODR &= ~S7C_DIGIT_PINS;
+  PC_ODR = (PC_ODR | SEG_PINS(PC0)) & ~segmentPinsC[segment];
+  PE_ODR = (PE_ODR | SEG_PINS(PE0)) & ~segmentPinsE[segment];
+  S7C_DIGIT_ODR |= digits;
 }
 
-// digitOff
+// setDimming
 /******************************************************************************/
-// Turns a digit off, as well as all segment pins
-void S7C_digitOff(uint8_t digitNum)
+// Sets the number of dark refresh steps after each lit segment, S7C_DIM_OFF
+// for the full brightness. The frame rate goes down with the duty.
+void S7C_setDimming(uint8_t darkSteps)
 {
-  for (uint8_t segmentNum = 0; segmentNum < numSegments; segmentNum++)
-  {
-    setPin(segmentPins[segmentNum], segmentOffVal);
-  }
-  setPin(digitPins[digitNum], digitOffVal);
+  dimming = darkSteps;
 }
 
 // setChars
 /******************************************************************************/
 // Displays the string on the display, as best as possible.
 // Only alphanumeric characters plus '-' and ' ' are supported
-void S7C_setChars(char str[])
+void S7C_setChars(const char str[])
 {
-  for (uint8_t digit = 0; digit < numDigits; digit++)
+  dirtyDigits = 0xFF;
+  for (uint8_t digit = 0; digit < S7C_NUM_DIGITS; digit++)
   {
     digitCodes[digit] = 0;
   }
 
   uint8_t strIdx = 0; // Current position within str[]
-  for (uint8_t digitNum = 0; digitNum < numDigits; digitNum++)
+  for (uint8_t digitNum = 0; digitNum < S7C_NUM_DIGITS; digitNum++)
   {
     char ch = str[strIdx];
     if (ch == '\0')
@@ -469,24 +227,64 @@ void S7C_setChars(char str[])
 
 void S7C_setSymbol(uint8_t digitNum, uint8_t symbol)
 {
-  digitCodes[digitNum >= numDigits ? numDigits - 1 : digitNum] = symbol;
+  digitNum = digitNum >= S7C_NUM_DIGITS ? S7C_NUM_DIGITS - 1 : digitNum;
+  dirtyDigits |= (1 << digitNum);
+  digitCodes[digitNum] = symbol;
 }
 
 void S7C_setDigit(uint8_t digitNum, uint8_t symbol)
 {
-  digitCodes[digitNum >= numDigits ? numDigits - 1 : digitNum] = digitCodeMap[symbol];
+  digitNum = digitNum >= S7C_NUM_DIGITS ? S7C_NUM_DIGITS - 1 : digitNum;
+  dirtyDigits |= (1 << digitNum);
+  digitCodes[digitNum] = digitCodeMap[symbol];
+}
+
+// setNumber
+/******************************************************************************/
+// Displays a decimal number with leading zeros on count digits from firstDigit,
+// values too large for the digits saturate to all nines. The digits are found
+// by repeated subtraction of the decades, at most 9 per digit, there is no
+// division, and nothing is done while neither the value nor the digits change.
+void S7C_setNumber(uint8_t firstDigit, uint8_t count, uint16_t value)
+{
+  static uint16_t lastValue = 0;
+  static uint8_t lastPlace = 0xFF;
+
+  if (count > sizeof(decades) / sizeof(decades[0]))
+    count = sizeof(decades) / sizeof(decades[0]);
+  if (firstDigit + count > S7C_NUM_DIGITS)
+    count = S7C_NUM_DIGITS - firstDigit;
+  uint8_t place = (firstDigit << 4) | count;
+  uint8_t mask = ((1 << count) - 1) << firstDigit;
+  if (value == lastValue && place == lastPlace && !(dirtyDigits & mask))
+    return;
+  lastValue = value;
+  lastPlace = place;
+  dirtyDigits &= ~mask;
+
+  const uint16_t *decade = decades + sizeof(decades) / sizeof(decades[0]) - count;
+  for (uint8_t digitNum = firstDigit; digitNum < firstDigit + count; digitNum++, decade++)
+  {
+    uint8_t digit = 0;
+    while (value >= *decade && digit < 9)
+    {
+      value -= *decade;
+      digit++;
+    }
+    digitCodes[digitNum] = numeralCodes[digit];
+  }
 }
 
 // blank
 /******************************************************************************/
 void S7C_blank(void)
 {
-  for (uint8_t digitNum = 0; digitNum < numDigits; digitNum++)
+  dirtyDigits = 0xFF;
+  for (uint8_t digitNum = 0; digitNum < S7C_NUM_DIGITS; digitNum++)
   {
     digitCodes[digitNum] = digitCodeMap[BLANK_IDX];
   }
-  S7C_segmentOff(0);
-  S7C_digitOff(0);
+  allOff();
 }
 
 /// END ///
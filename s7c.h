@@ -36,33 +36,37 @@
 #define SYM_SAVE 32
 #define SYM_TEMP 64
 
-#ifndef MAXNUMDIGITS
-#define MAXNUMDIGITS 8 // Can be increased, but the max number is 2^31
-#endif
+// Display wiring of the CXG-E60WT: 4 digits with common anodes, the current
+// limiting resistors on the digit pins and the decimal point not connected.
+// The display is multiplexed one segment at a time, a segment is lit by
+// pulling its pin low and the digits showing it by driving their pins high.
+#define S7C_NUM_DIGITS 4
+#define S7C_NUM_SEGMENTS 7
 
-// Use defines to link the hardware configurations to the correct numbers
-#define COMMON_CATHODE 0
-#define COMMON_ANODE 1
-#define N_TRANSISTORS 2
-#define P_TRANSISTORS 3
-#define NP_COMMON_CATHODE 1
-#define NP_COMMON_ANODE 0
+#define S7C_DIGIT_ODR PD_ODR // Digit n on bit n of the port
+#define S7C_DIGIT_PINS 0x0F  // PD0..PD3
+
+#define S7C_SEG_A PC7
+#define S7C_SEG_B PC5
+#define S7C_SEG_C PC3
+#define S7C_SEG_D PE5
+#define S7C_SEG_E PC2
+#define S7C_SEG_F PC6
+#define S7C_SEG_G PC1
+
+// Dark refresh steps after each lit segment, the duty is 1 / (1 + steps)
+#define S7C_DIM_OFF 0
+#define S7C_DIM_SLEEP 2 // a third of the brightness, 48Hz frames
 
 void S7C_init();
 
-void S7C_refreshDisplay(uint32_t ticks);
-void S7C_begin(uint8_t hardwareConfig, uint8_t numDigitsIn, uint8_t digitPinsIn[],
-               uint8_t segmentPinsIn[], uint8_t resOnSegmentsIn, uint8_t updateWithDelaysIn,
-               uint8_t leadingZerosIn, uint8_t disableDecPoint);
+void S7C_refreshStep();
+void S7C_setDimming(uint8_t darkSteps);
 
-void S7C_setChars(char str[]);
+void S7C_setChars(const char str[]);
 void S7C_blank(void);
 void S7C_setSymbol(uint8_t digitNum, uint8_t symbol);
 void S7C_setDigit(uint8_t digitNum, uint8_t symbol);
-
-void S7C_segmentOn(uint8_t segmentNum);
-void S7C_segmentOff(uint8_t segmentNum);
-void S7C_digitOn(uint8_t digitNum);
-void S7C_digitOff(uint8_t digitNum);
+void S7C_setNumber(uint8_t firstDigit, uint8_t count, uint16_t value);
 
 #endif // _S7C_h_
@@ -0,0 +1,92 @@
+//
+//  scheduler.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <scheduler.h>
+#include <stm8s.h>
+#include <clock.h>
+#include <prof.h>
+#include <watchdog.h>
+
+struct Task
+{
+    void (*run)(uint32_t nowTime);
+    uint16_t period;
+    uint16_t countdown; // milliseconds left before the next run
+};
+
+static struct Task _tasks[SCHED_MAX_TASKS];
+static uint8_t _numTasks = 0;
+static uint16_t _watched = 0; // one bit per task that has to beat
+static uint16_t _alive = 0;   // tasks completed since the last watchdog refresh
+
+void SCHED_addTask(void (*run)(uint32_t nowTime), uint16_t period)
+{
+    if (_numTasks >= SCHED_MAX_TASKS)
+        return;
+    _tasks[_numTasks].run = run;
+    _tasks[_numTasks].period = period;
+    _tasks[_numTasks].countdown = 0; // first run on the next tick
+    if (period <= SCHED_HEARTBEAT_MAX)
+        _watched |= (1 << _numTasks);
+    _numTasks++;
+}
+
+void SCHED_run()
+{
+    uint32_t lastTime = currentMillis();
+    while (1)
+    {
+        // Sleep until the millisecond counter moves, any interrupt wakes us up
+        uint32_t nowTime;
+        while ((nowTime = currentMillis()) == lastTime)
+        {
+            wfi();
+        }
+        uint16_t elapsed = nowTime - lastTime;
+        lastTime = nowTime;
+        PROF_MARK(PROF_TICK);
+
+        for (uint8_t i = 0; i < _numTasks; i++)
+        {
+            struct Task *task = &_tasks[i];
+            if (task->countdown > elapsed)
+            {
+                task->countdown -= elapsed;
+            }
+            else
+            {
+                // Late runs are not caught up, the period restarts from now
+                task->countdown = task->period;
+                task->run(nowTime);
+                _alive |= (1 << i);
+            }
+        }
+
+        // A task stuck in a loop or never run again ends in a watchdog reset
+        if ((_alive & _watched) == _watched)
+        {
+            WATCHDOG_refresh();
+            _alive = 0;
+        }
+    }
+}
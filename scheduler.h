@@ -0,0 +1,46 @@
+//
+//  scheduler.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <stdint.h>
+
+#define SCHED_MAX_TASKS 10
+#define SCHED_HEARTBEAT_MAX 500 // ms, tasks with longer periods are not watched
+
+/*
+ *  Register a task to be run every 'period' milliseconds
+ *  Tasks due on the same tick run in the registration order
+ */
+void SCHED_addTask(void (*run)(uint32_t nowTime), uint16_t period);
+
+/*
+ *  Run the registered tasks, the core waits in WFI between the
+ *  TIM4 millisecond ticks. The watchdog is refreshed once every task of
+ *  period up to SCHED_HEARTBEAT_MAX has completed since the last refresh.
+ *  Never returns.
+ */
+void SCHED_run();
+
+#endif //_SCHEDULER_H_
@@ -0,0 +1,66 @@
+//
+//  sim/plant.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <stdint.h>
+#include "plant.h"
+
+// Factory straight line of the firmware, MIN_ADC_RT..MAX_ADC_RT to MIN_HEAT..MAX_HEAT
+#define ADC_AT_50 35.0
+#define ADC_PER_DEGREE (95.0 / 400.0)
+
+static uint32_t _noiseSeed = 12345;
+
+static double noise()
+{
+    _noiseSeed = _noiseSeed * 1103515245u + 12345u;
+    return ((double)((_noiseSeed >> 16) & 0x7FFF) / 0x7FFF * 2.0 - 1.0) * PLANT_NOISE;
+}
+
+void PLANT_init(struct PLANT *plant)
+{
+    plant->tip = PLANT_AMBIENT;
+    plant->sensor = PLANT_AMBIENT;
+    plant->load = 0;
+    plant->energy = 0;
+}
+
+void PLANT_step(struct PLANT *plant, double dt, double heater)
+{
+    double power = PLANT_POWER * heater;
+    double loss = (plant->tip - PLANT_AMBIENT) / PLANT_RESISTANCE;
+    plant->tip += (power - loss - plant->load) * dt / PLANT_CAPACITY;
+    plant->sensor += (plant->tip - plant->sensor) * dt / PLANT_SENSOR_LAG;
+    plant->energy += power * dt;
+}
+
+uint16_t PLANT_adcTemp(struct PLANT *plant, int heaterOn)
+{
+    double adc = ADC_AT_50 + (plant->sensor - 50.0) * ADC_PER_DEGREE + noise();
+    if (heaterOn)
+        adc += PLANT_HEATER_OFFSET;
+    if (adc < 0)
+        adc = 0;
+    if (adc > 1023)
+        adc = 1023;
+    return (uint16_t)(adc + 0.5);
+}
@@ -0,0 +1,62 @@
+//
+//  sim/plant.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef _SIM_PLANT_H_
+#define _SIM_PLANT_H_
+
+// Lumped thermal model of the tip
+//   C * dT/dt = P * heater - (T - ambient) / R - load
+// the thermocouple follows the tip through a first order lag and is
+// converted to ADC counts with the inverse of the factory straight line
+
+#define PLANT_AMBIENT 25.0      // degrees
+#define PLANT_POWER 60.0        // W, heater at 100%
+#define PLANT_CAPACITY 2.5      // J/K
+#define PLANT_RESISTANCE 10.0   // K/W, to the ambient air
+#define PLANT_SENSOR_LAG 0.3    // s
+#define PLANT_HEATER_OFFSET 2.0 // ADC counts picked up while the heater is ON
+#define PLANT_NOISE 1.5         // ADC counts, peak
+
+struct PLANT
+{
+    double tip;    // degrees
+    double sensor; // degrees seen by the thermocouple
+    double load;   // W drawn by the work piece
+    double energy; // J delivered by the heater
+};
+
+void PLANT_init(struct PLANT *plant);
+
+/*
+ *  Advance the model
+ *  in: time step in seconds, heater duty 0..1
+ */
+void PLANT_step(struct PLANT *plant, double dt, double heater);
+
+/*
+ *  Thermocouple conversion, 10 bits
+ *  in: non-zero when the heater is ON at the moment of the conversion
+ */
+uint16_t PLANT_adcTemp(struct PLANT *plant, int heaterOn);
+
+#endif // _SIM_PLANT_H_
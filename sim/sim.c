@@ -0,0 +1,756 @@
+//
+//  sim/sim.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+// Host simulator: runs the firmware against the register layer of
+// sim/stm8s.h, a thermal model of the tip and a script of user actions,
+// then reports the regulation metrics of every phase of the script.
+//
+// usage: cxg-sim [script] [trace.csv]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <stm8s.h>
+#include <stm8s_pins.h>
+#include <clock.h>
+#include <eeprom.h>
+#include <sound.h>
+#include <adc.h>
+#include <uart.h>
+#include <power.h>
+#include <buttons.h>
+#include <telemetry.h>
+#include <watchdog.h>
+#include "plant.h"
+
+// main.c is built with main renamed, see the sim target of the Makefile
+#undef main
+void firmware_main();
+
+#define SIM_SUPPLY 24.0       // V, the heater gives PLANT_POWER at this supply
+#define SIM_UIN_ADC 680       // input voltage channel at SIM_SUPPLY
+#define SIM_HALT_STEP_US 500  // time step while TIM4 is stopped
+#define SIM_LSI_HZ 128000L     // AWU and IWDG clock
+#define SIM_UART_BAUD 115200L
+#define SIM_MAX_EVENTS 256
+#define SIM_MAX_PHASES 16
+#define SIM_EEPROM_SIZE 640 // bytes from EEPROM_START_ADDR, kept across a reboot
+
+#define HEATUP_BAND 5.0 // degrees, heat-up ends when the tip gets this close
+#define SETTLE_BAND 2.0 // degrees, settled when it stays this close
+#define STEADY_WINDOW 5000 // ms, steady-state error is averaged at the end of the phase
+
+volatile uint8_t SIM_mem[0x10000];
+
+enum EventType
+{
+    EV_PLUS,
+    EV_MINUS,
+    EV_MERCURY,
+    EV_LOAD,
+    EV_SUPPLY,
+    EV_SENSOR,
+    EV_PHASE,
+    EV_SEND,
+    EV_REBOOT,
+    EV_END
+};
+
+struct Event
+{
+    long time; // ms
+    int type;
+    double value;
+    char name[96];
+};
+
+struct Phase
+{
+    char name[16];
+    long start; // ms
+    long end;
+};
+
+static const char *_defaultScript =
+    "# time_ms command [value]\n"
+    "0      phase heat-up\n"
+    "40000  phase load\n"
+    "40000  load 20\n"
+    "45000  load 0\n"
+    "70000  end\n";
+
+static struct Event _events[SIM_MAX_EVENTS];
+static int _numEvents = 0;
+static int _nextEvent = 0;
+static struct Phase _phases[SIM_MAX_PHASES];
+static int _numPhases = 0;
+
+static char **_argv;
+
+static struct PLANT _plant;
+static double _supply = SIM_SUPPLY;
+static int _sensorFault = -1; // forced thermocouple reading, -1 for the plant
+static long _faultUs = -1;    // heater still ON since the fault
+static int _irqEnabled = 0;
+static int _irqCount = 0;
+static long _timeUs = 0;
+static long _awuTimeUs = 0;
+static long _iwdgUs = -1; // since the last watchdog refresh, negative while not started
+static long _uartBudget = 0; // byte times available to the UART, in us
+static long _buzzerEdges = 0;
+
+// Bytes on their way to the firmware, one per character time
+static uint8_t _rxQueue[1024];
+static int _rxHead = 0;
+static int _rxTail = 0;
+static long _rxBudget = 0;
+
+// Per millisecond trace
+static long _traceLen = 0;
+static long _traceCap = 0;
+static float *_traceTip = NULL;
+static short *_traceTarget = NULL;
+static FILE *_csv = NULL;
+
+// Telemetry decoder
+static struct TELEMETRY_FRAME _lastFrame;
+static int _haveFrame = 0;
+static long _frames = 0;
+static long _badFrames = 0;
+
+/******************************************************************************
+ *  Script
+ */
+
+static void parseScript(const char *text)
+{
+    char line[128];
+    while (*text)
+    {
+        size_t n = strcspn(text, "\n");
+        size_t len = n < sizeof(line) - 1 ? n : sizeof(line) - 1;
+        memcpy(line, text, len);
+        line[len] = 0;
+        text += n + (text[n] ? 1 : 0);
+
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+        long time;
+        char cmd[16], arg[96] = "";
+        if (sscanf(line, "%ld %15s %95s", &time, cmd, arg) < 2)
+            continue;
+        if (_numEvents >= SIM_MAX_EVENTS)
+        {
+            fprintf(stderr, "too many events\n");
+            exit(1);
+        }
+        struct Event *ev = &_events[_numEvents++];
+        ev->time = time;
+        ev->value = atof(arg);
+        snprintf(ev->name, sizeof(ev->name), "%s", arg);
+        if (!strcmp(cmd, "plus"))
+            ev->type = EV_PLUS;
+        else if (!strcmp(cmd, "minus"))
+            ev->type = EV_MINUS;
+        else if (!strcmp(cmd, "mercury"))
+            ev->type = EV_MERCURY;
+        else if (!strcmp(cmd, "load"))
+            ev->type = EV_LOAD;
+        else if (!strcmp(cmd, "sensor"))
+            ev->type = EV_SENSOR;
+        else if (!strcmp(cmd, "supply"))
+            ev->type = EV_SUPPLY;
+        else if (!strcmp(cmd, "phase"))
+            ev->type = EV_PHASE;
+        else if (!strcmp(cmd, "send"))
+            ev->type = EV_SEND;
+        else if (!strcmp(cmd, "reboot"))
+            ev->type = EV_REBOOT;
+        else if (!strcmp(cmd, "end"))
+            ev->type = EV_END;
+        else
+        {
+            fprintf(stderr, "unknown command '%s'\n", cmd);
+            exit(1);
+        }
+    }
+}
+
+static char *readFile(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = calloc(1, size + 1);
+    if (fread(text, 1, size, f) != (size_t)size)
+    {
+        perror(path);
+        exit(1);
+    }
+    fclose(f);
+    return text;
+}
+
+/******************************************************************************
+ *  Metrics
+ */
+
+static void report()
+{
+    long end = _traceLen;
+    if (_numPhases)
+        _phases[_numPhases - 1].end = end;
+
+    printf("%-10s %9s %9s %9s %9s %9s %9s\n", "phase", "target", "heat-up", "overshoot", "dip", "settling", "ss-error");
+    printf("%-10s %9s %9s %9s %9s %9s %9s\n", "", "C", "s", "C", "C", "s", "C");
+    for (int p = 0; p < _numPhases; p++)
+    {
+        struct Phase *ph = &_phases[p];
+        if (ph->end <= ph->start)
+            continue;
+        int target = _traceTarget[ph->end - 1];
+        long reached = -1, lastOut = -1;
+        double overshoot = 0, dip = 0;
+        for (long t = ph->start; t < ph->end; t++)
+        {
+            double err = _traceTip[t] - target;
+            if (reached < 0 && fabs(err) <= HEATUP_BAND)
+                reached = t;
+            if (reached >= 0 && err > overshoot)
+                overshoot = err;
+            if (reached >= 0 && -err > dip)
+                dip = -err;
+            if (fabs(err) > SETTLE_BAND)
+                lastOut = t;
+        }
+        long from = ph->end - STEADY_WINDOW < ph->start ? ph->start : ph->end - STEADY_WINDOW;
+        double sum = 0;
+        for (long t = from; t < ph->end; t++)
+            sum += _traceTip[t] - target;
+        double ssError = sum / (ph->end - from);
+
+        char heatUp[16], settling[16];
+        if (reached < 0)
+            strcpy(heatUp, "-");
+        else
+            snprintf(heatUp, sizeof(heatUp), "%.2f", (reached - ph->start) / 1000.0);
+        if (lastOut == ph->end - 1)
+            strcpy(settling, "-");
+        else
+            snprintf(settling, sizeof(settling), "%.2f", (lastOut < 0 ? 0 : lastOut + 1 - ph->start) / 1000.0);
+        printf("%-10s %9d %9s %9.1f %9.1f %9s %9.2f\n", ph->name, target, heatUp, overshoot, dip, settling, ssError);
+    }
+    printf("\nsimulated %.1f s, heater energy %.0f J, telemetry frames %ld (%ld bad), buzzer edges %ld\n",
+           _timeUs / 1e6, _plant.energy, _frames, _badFrames, _buzzerEdges);
+}
+
+static void finish()
+{
+    report();
+    if (_csv)
+        fclose(_csv);
+    exit(0);
+}
+
+/******************************************************************************
+ *  Peripherals
+ */
+
+static int tim2Running()
+{
+    return (TIM2_CR1 & (1 << TIM2_CR1_CEN)) && (CLK_PCKENR1 & (1 << CLK_PCKENR1_TIM2));
+}
+
+static long tim2Period()
+{
+    return ((TIM2_ARRH << 8) | TIM2_ARRL) + 1;
+}
+
+// Counts since the start of the simulation
+static long long tim2Counts(long timeUs)
+{
+    return ((long long)timeUs * (F_CPU / 1000000L)) >> (TIM2_PSCR & 0x0F);
+}
+
+// Fraction of the period PD4 is high, PWM mode 1 is high while CNT < CCR1, mode 2 the other way round
+static double heaterPinHigh(long cnt, int whole)
+{
+    if ((TIM2_CCER1 & 0x01) && tim2Running())
+    {
+        long period = tim2Period();
+        long ccr = (TIM2_CCR1H << 8) | TIM2_CCR1L;
+        int mode = (TIM2_CCMR1 >> 4) & 0x07;
+        if (mode == 0x04 || mode == 0x05) // forced inactive / active
+            return mode == 0x05 ? 1.0 : 0.0;
+        int mode2 = mode == 0x07;
+        double high = whole ? (ccr >= period ? 1.0 : (double)ccr / period) : (cnt < ccr);
+        return mode2 ? 1.0 - high : high;
+    }
+    return (PD_ODR & (1 << 4)) ? 1.0 : 0.0;
+}
+
+// Heater is ON when PD4 is low
+static double heaterDuty()
+{
+    return 1.0 - heaterPinHigh(0, 1);
+}
+
+// The scan takes a few microseconds, it is converted at once. ADON reads
+// back as 0 after the scan, so every start of the firmware is a new edge.
+static void adcScan(long cnt)
+{
+    if (!(ADC1_CR1 & (1 << ADC1_CR1_ADON)) || !(CLK_PCKENR2 & (1 << CLK_PCKENR2_ADC)))
+        return;
+    ADC1_CR1 &= ~(1 << ADC1_CR1_ADON);
+    uint16_t temp = (_sensorFault >= 0) ? _sensorFault : PLANT_adcTemp(&_plant, heaterPinHigh(cnt, 0) < 0.5);
+    ADC1_DB0RH = temp >> 8;
+    ADC1_DB0RL = temp & 0xFF;
+    uint16_t uin = SIM_UIN_ADC * _supply / SIM_SUPPLY + 0.5;
+    ADC1_DB1RH = uin >> 8;
+    ADC1_DB1RL = uin & 0xFF;
+    ADC1_CSR |= (1 << ADC1_CSR_EOC);
+    // Analog watchdog, 10-bit thresholds split 8 + 2 bits
+    uint16_t high = (ADC1_HTRH << 2) | (ADC1_HTRL & 0x03);
+    uint16_t low = (ADC1_LTRH << 2) | (ADC1_LTRL & 0x03);
+    if ((ADC1_AWCRL & 0x01) && (temp > high || temp < low))
+    {
+        ADC1_AWSRL |= 0x01;
+        ADC1_CSR |= (1 << ADC1_CSR_AWD);
+    }
+    if ((ADC1_CSR & (1 << ADC1_CSR_EOCIE)) || ((ADC1_CSR & (1 << ADC1_CSR_AWDIE)) && (ADC1_CSR & (1 << ADC1_CSR_AWD))))
+    {
+        ADC1_interrupt_handler();
+        _irqCount++;
+    }
+}
+
+static void setInput(int pin, int level)
+{
+    uint8_t mask = 1 << BIT(pin);
+    uint8_t old = IDR(pin);
+    IDR(pin) = level ? (old | mask) : (old & ~mask);
+    // Port B external interrupt, any edge is enough for the firmware
+    if (IDR(pin) != old && pin >= PB0 && pin <= PB7 && (CR2(pin) & mask) && _irqEnabled)
+    {
+        EXTI_PORTB_interrupt_handler();
+        _irqCount++;
+    }
+}
+
+// Frames are | sync1 | sync2 | length | payload | sum of payload |, only the
+// telemetry frame is used, the others (profiling) are checked and skipped
+static void decodeTelemetry(uint8_t byte)
+{
+    static uint8_t buf[256 + 4];
+    static unsigned pos = 0;
+    if ((pos == 0 && byte != TELEMETRY_SYNC1) || (pos == 1 && byte != TELEMETRY_SYNC2))
+    {
+        pos = 0;
+        return;
+    }
+    buf[pos++] = byte;
+    if (pos < 3 || pos < buf[2] + 4u)
+        return;
+    pos = 0;
+    uint8_t sum = 0;
+    for (unsigned i = 3; i < buf[2] + 3u; i++)
+        sum += buf[i];
+    if (sum != buf[buf[2] + 3])
+    {
+        _badFrames++;
+        return;
+    }
+    _frames++;
+    if (buf[2] && (buf[3] & 0x80) && buf[3] < 0x90)
+    {
+        printf("reply at %ld ms:", _timeUs / 1000);
+        for (unsigned i = 3; i < buf[2] + 3u; i++)
+            printf(" %02x", buf[i]);
+        printf("\n");
+    }
+    if (buf[2] == sizeof(struct TELEMETRY_FRAME) - 4)
+    {
+        memcpy(&_lastFrame, buf, sizeof(_lastFrame));
+        _haveFrame = 1;
+    }
+}
+
+// Frame the hex payload of a send command the way the host tools do
+static void queueRequest(const char *hex)
+{
+    uint8_t payload[48], sum = 0;
+    int len = 0;
+    unsigned byte;
+    while (len < (int)sizeof(payload) && sscanf(hex + 2 * len, "%2x", &byte) == 1)
+        payload[len++] = byte;
+    uint8_t header[3] = {TELEMETRY_SYNC1, TELEMETRY_SYNC2, len};
+    for (int i = 0; i < 3 + len + 1; i++)
+    {
+        uint8_t b = i < 3 ? header[i] : i < 3 + len ? payload[i - 3] : sum;
+        if (i >= 3 && i < 3 + len)
+            sum += b;
+        _rxQueue[_rxHead++ % sizeof(_rxQueue)] = b;
+    }
+}
+
+// Power cycle: the EEPROM and the plant survive, the program starts over
+// with the script carrying on after the reboot event
+static void reboot()
+{
+    char path[] = "/tmp/cxg-sim-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0 || write(fd, (const void *)&SIM_mem[EEPROM_START_ADDR], SIM_EEPROM_SIZE) != SIM_EEPROM_SIZE)
+    {
+        perror(path);
+        exit(1);
+    }
+    close(fd);
+    char state[128];
+    snprintf(state, sizeof(state), "%ld %.17g %.17g %s", _timeUs, _plant.tip, _plant.sensor, path);
+    setenv("SIM_REBOOT", state, 1);
+    printf("reboot at %ld ms\n", _timeUs / 1000);
+    fflush(stdout);
+    if (_csv)
+        fclose(_csv);
+    execv(_argv[0], _argv);
+    perror(_argv[0]);
+    exit(1);
+}
+
+// After a reboot: restore the EEPROM and the plant, the events up to the
+// reboot are skipped except the phases
+static void resume(const char *state)
+{
+    char path[64];
+    if (sscanf(state, "%ld %lf %lf %63s", &_timeUs, &_plant.tip, &_plant.sensor, path) != 4)
+        return;
+    FILE *f = fopen(path, "rb");
+    if (!f || fread((void *)&SIM_mem[EEPROM_START_ADDR], 1, SIM_EEPROM_SIZE, f) != SIM_EEPROM_SIZE)
+    {
+        perror(path);
+        exit(1);
+    }
+    fclose(f);
+    unlink(path);
+    _awuTimeUs = _timeUs;
+    while (_nextEvent < _numEvents && _events[_nextEvent].time * 1000 <= _timeUs)
+    {
+        struct Event *ev = &_events[_nextEvent++];
+        if (ev->type == EV_PHASE && _numPhases < SIM_MAX_PHASES)
+        {
+            if (_numPhases)
+                _phases[_numPhases - 1].end = ev->time;
+            strcpy(_phases[_numPhases].name, ev->name);
+            _phases[_numPhases].start = ev->time;
+            _numPhases++;
+        }
+    }
+}
+
+static void runEvents()
+{
+    while (_nextEvent < _numEvents && _events[_nextEvent].time * 1000 <= _timeUs)
+    {
+        struct Event *ev = &_events[_nextEvent++];
+        switch (ev->type)
+        {
+        case EV_PLUS:
+            setInput(PB7, ev->value == 0); // pressed pulls the pin low
+            break;
+        case EV_MINUS:
+            setInput(PB6, ev->value == 0);
+            break;
+        case EV_MERCURY:
+            setInput(PB5, !getPin(PB5));
+            break;
+        case EV_LOAD:
+            _plant.load = ev->value;
+            break;
+        case EV_SUPPLY:
+            _supply = ev->value;
+            break;
+        case EV_SENSOR:
+            _sensorFault = (!strcmp(ev->name, "open") || !strcmp(ev->name, "swap")) ? 1023 : !strcmp(ev->name, "short") ? 0 : -1;
+            if (!strcmp(ev->name, "swap"))
+                _plant.tip = _plant.sensor = PLANT_AMBIENT; // tip out, a cold one goes in at "sensor ok"
+            _faultUs = (_sensorFault >= 0) ? _timeUs : -1;
+            break;
+        case EV_PHASE:
+            if (_numPhases >= SIM_MAX_PHASES)
+                break;
+            if (_numPhases)
+                _phases[_numPhases - 1].end = ev->time;
+            strcpy(_phases[_numPhases].name, ev->name);
+            _phases[_numPhases].start = ev->time;
+            _numPhases++;
+            break;
+        case EV_SEND:
+            queueRequest(ev->name);
+            break;
+        case EV_REBOOT:
+            reboot();
+            break;
+        case EV_END:
+            finish();
+        }
+    }
+}
+
+static void recordTrace(double duty)
+{
+    long ms = _timeUs / 1000;
+    while (_traceLen <= ms)
+    {
+        if (_traceLen == _traceCap)
+        {
+            _traceCap = _traceCap ? _traceCap * 2 : 65536;
+            _traceTip = realloc(_traceTip, _traceCap * sizeof(*_traceTip));
+            _traceTarget = realloc(_traceTarget, _traceCap * sizeof(*_traceTarget));
+        }
+        _traceTip[_traceLen] = _plant.tip;
+        _traceTarget[_traceLen] = _haveFrame ? _lastFrame.targetHeatPoint : 0;
+        if (_csv && _traceLen % 10 == 0)
+        {
+            fprintf(_csv, "%ld,%.2f,%.2f,%d,%d,%.0f,%d\n", _traceLen, _plant.tip, _plant.sensor,
+                    _lastFrame.currentDegrees, _lastFrame.targetHeatPoint, duty * 100, _lastFrame.state);
+        }
+        _traceLen++;
+    }
+}
+
+// One step of simulated time: the length of a TIM4 period, or a fixed
+// step while the timer is stopped. The ISRs are called at the end of
+// the step, the firmware is never interrupted between two instructions.
+static void step()
+{
+    int tim4Running = (TIM4_CR1 & (1 << TIM4_CR1_CEN)) && (CLK_PCKENR1 & (1 << CLK_PCKENR1_TIM4));
+    long stepUs = tim4Running ? ((1L << TIM4_PSCR) * (TIM4_ARR + 1)) / (F_CPU / 1000000L) : SIM_HALT_STEP_US;
+    double duty = heaterDuty();
+    // The key sequence is not checked, a lock lasts until the next step
+    FLASH_IAPSR |= (1 << FLASH_IAPSR_DUL) | (1 << FLASH_IAPSR_EOP);
+    if (_faultUs >= 0 && duty == 0.0)
+    {
+        printf("sensor fault: heater off after %.1f ms\n", (_timeUs - _faultUs) / 1000.0);
+        _faultUs = -1;
+    }
+
+    // Resistive heater, the power goes with the square of the supply
+    PLANT_step(&_plant, stepUs / 1e6, duty * (_supply / SIM_SUPPLY) * (_supply / SIM_SUPPLY));
+    _timeUs += stepUs;
+    recordTrace(duty);
+    runEvents();
+
+    // TIM1 free running at F_CPU
+    int tim1Running = (TIM1_CR1 & (1 << TIM1_CR1_CEN)) && (CLK_PCKENR1 & (1 << CLK_PCKENR1_TIM1));
+    long long tim1From = (long long)(_timeUs - stepUs) * (F_CPU / 1000000L);
+    long long tim1To = (long long)_timeUs * (F_CPU / 1000000L);
+    if (tim1Running)
+    {
+        TIM1_CNTRH = (uint8_t)(tim1To >> 8);
+        TIM1_CNTRL = (uint8_t)tim1To;
+    }
+
+    if (!_irqEnabled)
+        return;
+
+    // Channel 4 compares of TIM1 within the step, the buzzer edges of the firmware
+    while (tim1Running && (TIM1_IER & (1 << TIM1_IER_CC4IE)))
+    {
+        long delta = (((TIM1_CCR4H << 8) | TIM1_CCR4L) - tim1From) & 0xFFFF;
+        tim1From += delta ? delta : 0x10000;
+        if (tim1From > tim1To)
+            break;
+        TIM1_SR1 |= (1 << TIM1_SR1_CC4IF);
+        TIM1_compare_handler();
+        _irqCount++;
+        _buzzerEdges++;
+    }
+
+    if (tim4Running && (TIM4_IER & (1 << TIM4_IER_UIE)))
+    {
+        TIM4_SR |= (1 << TIM4_SR_UIF);
+        TIM4_overflow_handler();
+        _irqCount++;
+    }
+
+    // Channel 2 compare of TIM2 within the step, the ADC trigger of the firmware
+    if (tim2Running())
+    {
+        long period = tim2Period();
+        long ccr2 = (TIM2_CCR2H << 8) | TIM2_CCR2L;
+        long long from = tim2Counts(_timeUs - stepUs), to = tim2Counts(_timeUs);
+        long long match = from - from % period + ccr2;
+        if (match <= from)
+            match += period;
+        if (match <= to && ccr2 < period)
+        {
+            TIM2_SR1 |= (1 << TIM2_SR1_CC2IF);
+            if (TIM2_IER & (1 << TIM2_IER_CC2IE))
+            {
+                TIM2_CC_interrupt_handler();
+                _irqCount++;
+                adcScan(ccr2);
+            }
+        }
+    }
+
+    // Scan started by the firmware code
+    adcScan(tim2Counts(_timeUs) % tim2Period());
+
+    // TX empty interrupt, one byte per character time
+    if ((CLK_PCKENR1 & (1 << CLK_PCKENR1_UART1)) && (UART1_CR2 & (1 << UART1_CR2_TEN)))
+    {
+        _uartBudget += stepUs;
+        while ((UART1_CR2 & (1 << UART1_CR2_TIEN)) && _uartBudget >= 10000000L / SIM_UART_BAUD)
+        {
+            UART1_TX_interrupt_handler();
+            _irqCount++;
+            if (!(UART1_CR2 & (1 << UART1_CR2_TIEN)))
+                break; // the ISR had nothing to send
+            _uartBudget -= 10000000L / SIM_UART_BAUD;
+            decodeTelemetry(UART1_DR);
+        }
+        if (!(UART1_CR2 & (1 << UART1_CR2_TIEN)))
+            _uartBudget = 0;
+    }
+
+    // RX not empty interrupt, one byte per character time
+    if ((CLK_PCKENR1 & (1 << CLK_PCKENR1_UART1)) && (UART1_CR2 & (1 << UART1_CR2_REN)) && _rxTail != _rxHead)
+    {
+        _rxBudget += stepUs;
+        while (_rxTail != _rxHead && _rxBudget >= 10000000L / SIM_UART_BAUD)
+        {
+            _rxBudget -= 10000000L / SIM_UART_BAUD;
+            UART1_DR = _rxQueue[_rxTail++ % sizeof(_rxQueue)];
+            UART1_SR |= (1 << UART1_SR_RXNE);
+            if (UART1_CR2 & (1 << UART1_CR2_RIEN))
+            {
+                UART1_RX_interrupt_handler();
+                _irqCount++;
+            }
+        }
+    }
+
+    // Only the last key written is seen, enable and refresh both reload the counter
+    if (IWDG_KR == IWDG_KEY_REFRESH || IWDG_KR == IWDG_KEY_ENABLE)
+    {
+        IWDG_KR = 0;
+        _iwdgUs = 0;
+    }
+    else if (_iwdgUs >= 0)
+    {
+        _iwdgUs += stepUs;
+        if (_iwdgUs >= 2LL * (4 << IWDG_PR) * (IWDG_RLR + 1) * 1000000L / SIM_LSI_HZ)
+        {
+            // Reported only, the firmware carries on
+            printf("watchdog reset at %.1f ms\n", _timeUs / 1000.0);
+            _iwdgUs = 0;
+        }
+    }
+
+    long awuPeriodUs = AWU_TBR ? (1LL << (AWU_TBR - 1)) * AWU_APR * 1000000L / SIM_LSI_HZ : 0;
+    if ((AWU_CSR & (1 << AWU_CSR_AWUEN)) && _timeUs - _awuTimeUs >= awuPeriodUs)
+    {
+        _awuTimeUs = _timeUs;
+        AWU_CSR |= (1 << AWU_CSR_AWUF);
+        AWU_interrupt_handler();
+        _irqCount++;
+    }
+}
+
+/******************************************************************************
+ *  CPU
+ */
+
+void SIM_enableInterrupts(void)
+{
+    _irqEnabled = 1;
+}
+
+void SIM_disableInterrupts(void)
+{
+    _irqEnabled = 0;
+}
+
+void SIM_wfi(void)
+{
+    int count = _irqCount;
+    _irqEnabled = 1;
+    while (_irqCount == count)
+        step();
+}
+
+void SIM_halt(void)
+{
+    // Same as wfi in the model, the stopped clocks keep TIM4 and the ADC quiet
+    SIM_wfi();
+}
+
+static void resetRegisters()
+{
+    memset((void *)SIM_mem, 0, sizeof(SIM_mem));
+    CLK_PCKENR1 = 0xFF;
+    CLK_PCKENR2 = 0xFF;
+    TIM4_ARR = 0xFF;
+    PB_IDR = 0xFF; // pull-ups, buttons released
+    // EEPROM is always unlocked and programming completes at once
+    FLASH_IAPSR = (1 << FLASH_IAPSR_DUL) | (1 << FLASH_IAPSR_EOP);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *rebooted = getenv("SIM_REBOOT");
+    _argv = argv;
+    parseScript(argc > 1 ? readFile(argv[1]) : _defaultScript);
+    if (argc > 2)
+    {
+        _csv = fopen(argv[2], rebooted ? "a" : "w");
+        if (!_csv)
+        {
+            perror(argv[2]);
+            return 1;
+        }
+        if (!rebooted)
+            fprintf(_csv, "ms,tip,sensor,degrees,target,duty,state\n");
+    }
+
+    resetRegisters();
+    PLANT_init(&_plant);
+    if (rebooted)
+    {
+        unsetenv("SIM_REBOOT");
+        resume(rebooted);
+    }
+    runEvents();
+    firmware_main(); // never returns, the end event of the script reports and exits
+    return 0;
+}
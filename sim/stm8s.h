@@ -0,0 +1,54 @@
+//
+//  sim/stm8s.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+// Host build register layer: every address of the STM8 memory map is a byte
+// of SIM_mem[], the firmware sources compile unchanged against it.
+// The sources include <stm8s.h>, the simulator build puts sim/ first on the
+// include path so they get this file, which then includes the real header.
+
+#ifndef _SIM_STM8S_H_
+#define _SIM_STM8S_H_
+
+#include <stdint.h>
+
+extern volatile uint8_t SIM_mem[0x10000];
+
+void SIM_enableInterrupts(void);
+void SIM_disableInterrupts(void);
+void SIM_wfi(void);
+void SIM_halt(void);
+
+#define _MEM_(mem_addr) (SIM_mem[(uint16_t)(mem_addr)])
+#define _SFR_(mem_addr) (SIM_mem[(uint16_t)(mem_addr)])
+#define _SFR16_(mem_addr) (*(volatile uint16_t *)&SIM_mem[(uint16_t)(mem_addr)])
+
+#define __interrupt(x)
+#define enable_interrupts() SIM_enableInterrupts();
+#define disable_interrupts() SIM_disableInterrupts();
+#define nop()
+#define halt() SIM_halt();
+#define wfi() SIM_wfi();
+
+#include "../stm8s.h"
+
+#endif // _SIM_STM8S_H_
@@ -0,0 +1,150 @@
+//
+//  sound.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <stm8s.h>
+#include <main.h>
+#include <sound.h>
+
+#define BEEP_DURATION 50 // ms, each tone of a chirp
+#define BUZZER_PIN 3     // PA3
+
+struct Note
+{
+    uint8_t tone;
+    uint8_t length; // beepTask runs
+};
+
+extern struct EEPROM_DATA _eepromData;
+
+// TIM1 counts per half period of the tones
+static const uint16_t _halfPeriods[] = {0, F_CPU / 1000, F_CPU / 2000};
+
+static volatile uint16_t _halfPeriod = 0; // of the playing tone, 0 when silent
+static uint16_t _nextEdge;                // TIM1 count of the next buzzer toggle
+
+// Melody, filled by beep() and played by beepTask, both in the foreground
+static struct Note _notes[SOUND_QUEUE];
+static uint8_t _head = 0;
+static uint8_t _tail = 0;
+static uint8_t _noteTime = 0; // beepTask runs left on the current note
+
+void TIM1_compare_handler() __interrupt(TIM1_CC_ISR)
+{
+    TIM1_SR1 &= ~(1 << TIM1_SR1_CC4IF);
+    PA_ODR ^= (1 << BUZZER_PIN);
+    _nextEdge += _halfPeriod;
+    TIM1_CCR4H = _nextEdge >> 8;
+    TIM1_CCR4L = _nextEdge;
+}
+
+static void setTone(uint8_t tone)
+{
+    uint16_t halfPeriod = _halfPeriods[tone];
+    disable_interrupts();
+    if (!halfPeriod)
+    {
+        TIM1_IER &= ~(1 << TIM1_IER_CC4IE);
+        PA_ODR &= ~(1 << BUZZER_PIN); // no DC through the buzzer coil
+    }
+    else if (!_halfPeriod)
+    {
+        // The high byte has to be read first, it latches the low byte
+        uint8_t h = TIM1_CNTRH;
+        _nextEdge = ((h << 8) | TIM1_CNTRL) + halfPeriod;
+        TIM1_CCR4H = _nextEdge >> 8;
+        TIM1_CCR4L = _nextEdge;
+        TIM1_SR1 &= ~(1 << TIM1_SR1_CC4IF);
+        TIM1_IER |= (1 << TIM1_IER_CC4IE);
+    }
+    _halfPeriod = halfPeriod; // a playing tone changes on its next edge
+    enable_interrupts();
+}
+
+void SOUND_init()
+{
+    PA_DDR |= (1 << BUZZER_PIN); // configure PA3 as output
+    PA_CR1 |= (1 << BUZZER_PIN); // push-pull mode
+    PA_CR2 |= (1 << BUZZER_PIN); // fast mode
+
+    // Same time base as the profiler, channel 4 stays in frozen mode
+    TIM1_PSCRH = 0;
+    TIM1_PSCRL = 0;
+    TIM1_ARRH = 0xFF;
+    TIM1_ARRL = 0xFF;
+    TIM1_EGR = (1 << TIM1_EGR_UG); // load the prescaler
+    TIM1_CR1 = (1 << TIM1_CR1_CEN);
+}
+
+uint8_t SOUND_queue(uint8_t tone, uint16_t length)
+{
+    uint8_t head = (_head + 1) & (SOUND_QUEUE - 1);
+    if (head == _tail)
+        return 0;
+    _notes[_head].tone = tone;
+    _notes[_head].length = length / BEEP_PERIOD;
+    _head = head;
+    return 1;
+}
+
+void SOUND_stop()
+{
+    _tail = _head;
+    _noteTime = 0;
+    setTone(TONE_OFF);
+}
+
+static void playChirps(uint8_t chirps)
+{
+    if (!_eepromData.enableSound)
+        return;
+    while (chirps--)
+    {
+        SOUND_queue(TONE_500HZ, BEEP_DURATION);
+        SOUND_queue(TONE_1KHZ, BEEP_DURATION);
+    }
+}
+
+void beep()
+{
+    playChirps(1);
+}
+
+void beepAlarm()
+{
+    playChirps(4);
+}
+
+void beepTask(uint32_t nowTime)
+{
+    if (_noteTime && --_noteTime)
+        return;
+    if (_tail == _head)
+    {
+        if (_halfPeriod)
+            setTone(TONE_OFF);
+        return;
+    }
+    setTone(_notes[_tail].tone);
+    _noteTime = _notes[_tail].length;
+    _tail = (_tail + 1) & (SOUND_QUEUE - 1);
+}
@@ -0,0 +1,67 @@
+//
+//  sound.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef _SOUND_H_
+#define _SOUND_H_
+
+#include <stm8s.h>
+
+void TIM1_compare_handler() __interrupt(TIM1_CC_ISR);
+
+#define BEEP_PERIOD 10 // beepTask period, ms
+#define SOUND_QUEUE 16 // notes, power of 2, one slot stays free
+
+enum SOUND_TONES
+{
+    TONE_OFF, // a rest
+    TONE_500HZ,
+    TONE_1KHZ,
+};
+
+/*
+ *  Configure the buzzer pin and start TIM1 free running at F_CPU,
+ *  the edges of the tone are compare interrupts of channel 4
+ */
+void SOUND_init();
+
+/*
+ *  Append a note to the melody
+ *  in: tone, length in ms (rounded down to BEEP_PERIOD)
+ *  out: 0 when the queue is full and the note is dropped
+ */
+uint8_t SOUND_queue(uint8_t tone, uint16_t length);
+
+/*
+ *  Silence the buzzer and drop the queued notes
+ */
+void SOUND_stop();
+
+void beep();
+void beepAlarm();
+
+/*
+ *  Sound sequencer, scheduler task
+ */
+void beepTask(uint32_t nowTime);
+
+#endif //_SOUND_H_
@@ -0,0 +1,86 @@
+//
+//  stack.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <stm8s.h>
+#include <stack.h>
+
+#if defined(__SDCC)
+
+static uint16_t stackPointer() __naked
+{
+    __asm
+        ldw x, sp
+        ret
+    __endasm;
+}
+
+// The linker places the INITIALIZED area after DATA, the stack owns the rest
+static uint16_t dataEnd() __naked
+{
+    __asm
+        ldw x, #s_INITIALIZED
+        addw x, #l_INITIALIZED
+        ret
+    __endasm;
+}
+
+#else
+
+// Host build, the firmware stack is not in the simulated RAM, nothing is painted
+static uint16_t stackPointer()
+{
+    return STACK_RAM_END;
+}
+
+static uint16_t dataEnd()
+{
+    return STACK_RAM_END + 1;
+}
+
+#endif
+
+// Lowest address the stack has overwritten
+static uint16_t lowWaterMark()
+{
+    uint16_t address = dataEnd();
+    while (address <= STACK_RAM_END && _MEM_(address) == STACK_PATTERN)
+        address++;
+    return address;
+}
+
+void STACK_paint()
+{
+    uint16_t top = stackPointer() - STACK_MARGIN;
+    for (uint16_t address = dataEnd(); address < top; address++)
+        _MEM_(address) = STACK_PATTERN;
+}
+
+uint16_t STACK_highWater()
+{
+    return STACK_RAM_END + 1 - lowWaterMark();
+}
+
+uint16_t STACK_headroom()
+{
+    return lowWaterMark() - dataEnd();
+}
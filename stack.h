@@ -0,0 +1,50 @@
+//
+//  stack.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef _STACK_H_
+#define _STACK_H_
+
+#include <stdint.h>
+
+#define STACK_RAM_END 0x03FF // last RAM byte, the stack grows down from there
+#define STACK_PATTERN 0xCD   // paint of the bytes the stack never reached
+#define STACK_MARGIN 4       // bytes below the stack pointer left alone by the paint
+
+/*
+ *  Fill the free RAM between the static data and the stack pointer with
+ *  the pattern, to be called first thing at startup
+ */
+void STACK_paint();
+
+/*
+ *  The deepest stack use since the paint, in bytes
+ */
+uint16_t STACK_highWater();
+
+/*
+ *  Bytes between the static data and the deepest stack use,
+ *  the stack overflows into the variables when it reaches 0
+ */
+uint16_t STACK_headroom();
+
+#endif //_STACK_H_
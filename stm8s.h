@@ -28,9 +28,12 @@
 
 #include <stdint.h>
 
+/* a host build may provide its own memory layer, see sim/stm8s.h */
+#ifndef _MEM_
 #define _MEM_(mem_addr) (*(volatile uint8_t *)(mem_addr))
 #define _SFR_(mem_addr) (*(volatile uint8_t *)((mem_addr)))
 #define _SFR16_(mem_addr) (*(volatile uint16_t *)((mem_addr)))
+#endif
 
 /* PORT A */
 #define PA_BASE_ADDRESS 0x5000
@@ -126,9 +129,11 @@
 #define FLASH_FPR _SFR_(FLASH_BASE_ADDRESS + 0x03)
 #define FLASH_NFPR _SFR_(FLASH_BASE_ADDRESS + 0x04)
 #define FLASH_IAPSR _SFR_(FLASH_BASE_ADDRESS + 0x05)
+#define FLASH_IAPSR_HVOFF 6
 #define FLASH_IAPSR_DUL 3
 #define FLASH_IAPSR_EOP 2
 #define FLASH_IAPSR_PUL 1
+#define FLASH_IAPSR_WR_PG_DIS 0
 #define FLASH_PUKR _SFR_(FLASH_BASE_ADDRESS + 0x08)
 #define FLASH_PUKR_KEY1 0x56
 #define FLASH_PUKR_KEY2 0xAE
@@ -139,6 +144,10 @@
 /* EXTI */
 #define EXTI_BASE_ADDRESS 0x50A0
 #define EXTI_CR1 _SFR_(EXTI_BASE_ADDRESS + 0x00)
+#define EXTI_CR1_PDIS 6
+#define EXTI_CR1_PCIS 4
+#define EXTI_CR1_PBIS 2
+#define EXTI_CR1_PAIS 0
 #define EXTI_CR2 _SFR_(EXTI_BASE_ADDRESS + 0x01)
 
 /* RST */
@@ -166,10 +175,19 @@
 #define CLK_SWCR_SWBSY 0
 #define CLK_CKDIVR _SFR_(CLK_BASE_ADDRESS + 0x06)
 #define CLK_PCKENR1 _SFR_(CLK_BASE_ADDRESS + 0x07)
+#define CLK_PCKENR1_TIM1 7
+#define CLK_PCKENR1_TIM3 6
+#define CLK_PCKENR1_TIM2 5
+#define CLK_PCKENR1_TIM4 4
+#define CLK_PCKENR1_UART1 3
+#define CLK_PCKENR1_SPI 1
+#define CLK_PCKENR1_I2C 0
 #define CLK_CSSR _SFR_(CLK_BASE_ADDRESS + 0x08)
 #define CLK_CCOR _SFR_(CLK_BASE_ADDRESS + 0x09)
 #define CLK_CCOR_CCOEN 0
 #define CLK_PCKENR2 _SFR_(CLK_BASE_ADDRESS + 0x0A)
+#define CLK_PCKENR2_ADC 3
+#define CLK_PCKENR2_AWU 2
 #define CLK_HSITRIMR _SFR_(CLK_BASE_ADDRESS + 0x0C)
 #define CLK_SWIMCCR _SFR_(CLK_BASE_ADDRESS + 0x0D)
 
@@ -272,11 +290,19 @@
 #define UART1_SR_TXE 7
 #define UART1_SR_TC 6
 #define UART1_SR_RXNE 5
+#define UART1_SR_IDLE 4
+#define UART1_SR_OR 3
+#define UART1_SR_NF 2
+#define UART1_SR_FE 1
+#define UART1_SR_PE 0
 #define UART1_DR _SFR_(UART1_BASE_ADDRESS + 0x01)
 #define UART1_BRR1 _SFR_(UART1_BASE_ADDRESS + 0x02)
 #define UART1_BRR2 _SFR_(UART1_BASE_ADDRESS + 0x03)
 #define UART1_CR1 _SFR_(UART1_BASE_ADDRESS + 0x04)
 #define UART1_CR2 _SFR_(UART1_BASE_ADDRESS + 0x05)
+#define UART1_CR2_TIEN 7
+#define UART1_CR2_TCIEN 6
+#define UART1_CR2_RIEN 5
 #define UART1_CR2_TEN 3
 #define UART1_CR2_REN 2
 #define UART1_CR3 _SFR_(UART1_BASE_ADDRESS + 0x06)
@@ -344,13 +370,17 @@
 /* TIM1 */
 #define TIM1_BASE_ADDRESS 0x5250
 #define TIM1_CR1 _SFR_(TIM1_BASE_ADDRESS + 0x00)
+#define TIM1_CR1_CEN 0
 #define TIM1_CR2 _SFR_(TIM1_BASE_ADDRESS + 0x01)
 #define TIM1_SMCR _SFR_(TIM1_BASE_ADDRESS + 0x02)
 #define TIM1_ETR _SFR_(TIM1_BASE_ADDRESS + 0x03)
 #define TIM1_IER _SFR_(TIM1_BASE_ADDRESS + 0x04)
+#define TIM1_IER_CC4IE 4
 #define TIM1_SR1 _SFR_(TIM1_BASE_ADDRESS + 0x05)
+#define TIM1_SR1_CC4IF 4
 #define TIM1_SR2 _SFR_(TIM1_BASE_ADDRESS + 0x06)
 #define TIM1_EGR _SFR_(TIM1_BASE_ADDRESS + 0x07)
+#define TIM1_EGR_UG 0
 #define TIM1_CCMR1 _SFR_(TIM1_BASE_ADDRESS + 0x08)
 #define TIM1_CCMR2 _SFR_(TIM1_BASE_ADDRESS + 0x09)
 #define TIM1_CCMR3 _SFR_(TIM1_BASE_ADDRESS + 0x0A)
@@ -392,7 +422,11 @@
 #define TIM2_CR1_UDIS 1
 #define TIM2_CR1_CEN 0
 #define TIM2_IER _SFR_(TIM2_BASE_ADDRESS + 0x03)
+#define TIM2_IER_CC2IE 2
+#define TIM2_IER_CC1IE 1
 #define TIM2_SR1 _SFR_(TIM2_BASE_ADDRESS + 0x04)
+#define TIM2_SR1_CC2IF 2
+#define TIM2_SR1_CC1IF 1
 #define TIM2_SR2 _SFR_(TIM2_BASE_ADDRESS + 0x05)
 #define TIM2_EGR _SFR_(TIM2_BASE_ADDRESS + 0x06)
 #define TIM2_EGR_TG 6
@@ -539,6 +573,24 @@
 #define ADC1_DB0R _SFR16_(ADC1_BASE_ADDRESS + 0x00)
 #define ADC1_DB0RH _SFR_(ADC1_BASE_ADDRESS + 0x00)
 #define ADC1_DB0RL _SFR_(ADC1_BASE_ADDRESS + 0x01)
+#define ADC1_DB1R _SFR16_(ADC1_BASE_ADDRESS + 0x02)
+#define ADC1_DB1RH _SFR_(ADC1_BASE_ADDRESS + 0x02)
+#define ADC1_DB1RL _SFR_(ADC1_BASE_ADDRESS + 0x03)
+#define ADC1_DB2R _SFR16_(ADC1_BASE_ADDRESS + 0x04)
+#define ADC1_DB2RH _SFR_(ADC1_BASE_ADDRESS + 0x04)
+#define ADC1_DB2RL _SFR_(ADC1_BASE_ADDRESS + 0x05)
+#define ADC1_DB3R _SFR16_(ADC1_BASE_ADDRESS + 0x06)
+#define ADC1_DB3RH _SFR_(ADC1_BASE_ADDRESS + 0x06)
+#define ADC1_DB3RL _SFR_(ADC1_BASE_ADDRESS + 0x07)
+#define ADC1_DB4R _SFR16_(ADC1_BASE_ADDRESS + 0x08)
+#define ADC1_DB4RH _SFR_(ADC1_BASE_ADDRESS + 0x08)
+#define ADC1_DB4RL _SFR_(ADC1_BASE_ADDRESS + 0x09)
+#define ADC1_DB5R _SFR16_(ADC1_BASE_ADDRESS + 0x0A)
+#define ADC1_DB5RH _SFR_(ADC1_BASE_ADDRESS + 0x0A)
+#define ADC1_DB5RL _SFR_(ADC1_BASE_ADDRESS + 0x0B)
+#define ADC1_DB6R _SFR16_(ADC1_BASE_ADDRESS + 0x0C)
+#define ADC1_DB6RH _SFR_(ADC1_BASE_ADDRESS + 0x0C)
+#define ADC1_DB6RL _SFR_(ADC1_BASE_ADDRESS + 0x0D)
 #define ADC1_DB7R _SFR16_(ADC1_BASE_ADDRESS + 0x0E)
 #define ADC1_DB7RH _SFR_(ADC1_BASE_ADDRESS + 0x0E)
 #define ADC1_DB7RL _SFR_(ADC1_BASE_ADDRESS + 0x0F)
@@ -552,6 +604,7 @@
 #define ADC1_CSR_EOC 7
 #define ADC1_CSR_AWD 6
 #define ADC1_CSR_EOCIE 5
+#define ADC1_CSR_AWDIE 4
 #define ADC1_CSR_CH3 3
 #define ADC1_CSR_CH2 2
 #define ADC1_CSR_CH1 1
@@ -684,9 +737,12 @@
 #define CPU_CCR _MEM_(0x7F0A)
 
 /* misc inline macros */
+#ifndef enable_interrupts
 #define enable_interrupts() __asm__("rim");
 #define disable_interrupts() __asm__("sim");
 #define nop() __asm__("nop");
 #define halt() __asm__("halt");
+#define wfi() __asm__("wfi");
+#endif
 
 #endif /* _STM8S_H_ */
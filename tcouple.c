@@ -0,0 +1,59 @@
+//
+//  tcouple.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <tcouple.h>
+
+static const int16_t *_table;
+static int16_t _slopes[TC_NUM_POINTS - 1]; // degrees per table step
+
+void TC_defaultTable(int16_t table[], int16_t adc1, int16_t deg1, int16_t adc2, int16_t deg2)
+{
+    for (uint8_t i = 0; i < TC_NUM_POINTS; i++)
+    {
+        int16_t adc = (i << TC_STEP_SHIFT) >> TC_EXTRA_BITS;
+        table[i] = deg1 + (int32_t)(deg2 - deg1) * (adc - adc1) / (adc2 - adc1);
+    }
+}
+
+void TC_extrapolateEnds(int16_t table[])
+{
+    table[0] = 2 * table[1] - table[2];
+    table[TC_NUM_POINTS - 1] = 2 * table[TC_NUM_POINTS - 2] - table[TC_NUM_POINTS - 3];
+}
+
+void TC_init(const int16_t table[])
+{
+    _table = table;
+    for (uint8_t i = 0; i < TC_NUM_POINTS - 1; i++)
+    {
+        _slopes[i] = table[i + 1] - table[i];
+    }
+}
+
+int16_t TC_degrees(uint16_t adc)
+{
+    uint16_t idx = adc >> TC_STEP_SHIFT;
+    if (idx >= TC_NUM_POINTS - 1)
+        return _table[TC_NUM_POINTS - 1];
+    return _table[idx] + (((int32_t)_slopes[idx] * (adc & TC_STEP_MASK)) >> TC_STEP_SHIFT);
+}
@@ -0,0 +1,60 @@
+//
+//  tcouple.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef _TCOUPLE_H_
+#define _TCOUPLE_H_
+
+#include <stdint.h>
+
+// The input is the oversampled ADC value with TC_EXTRA_BITS fractional bits
+// Calibration table breakpoints are every 32 ADC counts, at point << TC_STEP_SHIFT
+// so the segment is found with a shift and no division is needed
+#define TC_EXTRA_BITS 2
+#define TC_STEP_SHIFT (5 + TC_EXTRA_BITS)
+#define TC_STEP_MASK ((1 << TC_STEP_SHIFT) - 1)
+#define TC_NUM_POINTS 6 // ADC 0..160, above the table the last point is returned
+
+/*
+ *  Fill in the table with the straight line through two (ADC, degrees) points
+ *  in: plain ADC counts, without the extra bits
+ */
+void TC_defaultTable(int16_t table[], int16_t adc1, int16_t deg1, int16_t adc2, int16_t deg2);
+
+/*
+ *  Extrapolate the outermost points from their inner neighbours,
+ *  they are out of the working range and cannot be measured
+ */
+void TC_extrapolateEnds(int16_t table[]);
+
+/*
+ *  Use the table for the conversions, precomputes the segment slopes
+ *  Has to be called again after the table was changed
+ */
+void TC_init(const int16_t table[]);
+
+/*
+ *  Degrees for the ADC value, piecewise linear between the table points
+ */
+int16_t TC_degrees(uint16_t adc);
+
+#endif //_TCOUPLE_H_
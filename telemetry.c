@@ -0,0 +1,78 @@
+//
+//  telemetry.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <telemetry.h>
+#include <uart.h>
+
+#define PAYLOAD_SIZE (sizeof(struct TELEMETRY_FRAME) - 4)
+
+void TELEMETRY_init()
+{
+    UART_init(TELEMETRY_BAUD);
+}
+
+void TELEMETRY_send(struct TELEMETRY_FRAME *frame)
+{
+    TELEMETRY_sendFrame((uint8_t *)frame, PAYLOAD_SIZE);
+}
+
+void TELEMETRY_sendFrame(uint8_t *frame, uint8_t length)
+{
+    uint8_t sum = 0;
+    for (uint8_t i = 0; i < length; i++)
+    {
+        sum += frame[3 + i];
+    }
+    frame[0] = TELEMETRY_SYNC1;
+    frame[1] = TELEMETRY_SYNC2;
+    frame[2] = length;
+    frame[3 + length] = sum;
+    UART_write(frame, length + 4);
+}
+
+uint8_t TELEMETRY_receiveFrame(uint8_t *frame, uint8_t size)
+{
+    static uint8_t pos = 0;
+    uint8_t byte;
+    while (UART_read(&byte))
+    {
+        if (pos == 1 && byte != TELEMETRY_SYNC2)
+            pos = 0;
+        if (pos == 0 && byte != TELEMETRY_SYNC1)
+            continue;
+        frame[pos++] = byte;
+        if (pos == 3 && byte + 4u > size)
+            pos = 0;
+        if (pos < 3 || pos < frame[2] + 4u)
+            continue;
+        pos = 0;
+        uint8_t sum = 0;
+        for (uint8_t i = 0; i < frame[2]; i++)
+        {
+            sum += frame[3 + i];
+        }
+        if (sum == frame[3 + frame[2]])
+            return frame[2];
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+//
+//  telemetry.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stdint.h>
+
+#define TELEMETRY_BAUD 115200
+#define TELEMETRY_SYNC1 0xA5
+#define TELEMETRY_SYNC2 0x5A
+
+/*
+ *  Frame on the wire, multi-byte fields are big endian (the STM8 order)
+ *  | 0xA5 | 0x5A | length of payload | payload | sum of payload bytes |
+ */
+struct TELEMETRY_FRAME
+{
+    uint8_t sync1;
+    uint8_t sync2;
+    uint8_t length;
+    // payload, ordered so that no compiler pads it
+    uint8_t state;       // working mode
+    uint32_t time;       // currentMillis()
+    uint16_t adcTempRaw; // last thermocouple conversion
+    uint16_t adcTemp;    // filtered thermocouple, TC_EXTRA_BITS fraction
+    uint16_t adcUIn;     // filtered input voltage
+    int16_t currentDegrees;
+    int16_t targetHeatPoint;
+    uint8_t heaterPower; // percents
+    // trailer
+    uint8_t checksum;
+};
+
+/*
+ *  Configure the serial port
+ */
+void TELEMETRY_init();
+
+/*
+ *  Fill in the header and the checksum and queue the frame,
+ *  the frame is dropped when the previous ones are still being sent
+ */
+void TELEMETRY_send(struct TELEMETRY_FRAME *frame);
+
+/*
+ *  Same for any frame laid out as | sync1 | sync2 | length | payload | checksum |
+ *  in: frame, payload length
+ */
+void TELEMETRY_sendFrame(uint8_t *frame, uint8_t length);
+
+/*
+ *  Assemble the incoming frames, same layout as the outgoing ones,
+ *  longer frames and frames with a bad sum are dropped
+ *  in: buffer for the largest accepted frame, its size
+ *  out: payload length once a frame is complete, 0 otherwise
+ */
+uint8_t TELEMETRY_receiveFrame(uint8_t *frame, uint8_t size);
+
+#endif //_TELEMETRY_H_
@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+#
+#  budget.py
+#  cxg-60ewt
+#
+#  RAM, flash and stack frame budget per module, read from the SDCC
+#  assembler output of the build (obj/*.sym and obj/*.asm).
+#
+#  usage: budget.py [--ram bytes] [--flash bytes] objdir
+#
+
+import argparse
+import glob
+import os
+import re
+import sys
+
+FLASH_AREAS = ("HOME", "GSINIT", "GSFINAL", "CODE", "CONST", "INITIALIZER")
+RAM_AREAS = ("DATA", "INITIALIZED")
+
+AREA_RE = re.compile(r"^\s*\d+\s+(\S+)\s+size\s+([0-9A-Fa-f]+)\s+flags")
+FUNCTION_RE = re.compile(r"^;\s+function\s+(\S+)")
+FRAME_RE = re.compile(r"^\s+sub\s+sp,\s*#(0x[0-9A-Fa-f]+|\d+)")
+ISR_RE = re.compile(r"^\s+iret\b")
+
+
+def areas(symfile):
+    sizes = {}
+    with open(symfile) as f:
+        for line in f:
+            match = AREA_RE.match(line)
+            if match:
+                sizes[match.group(1)] = sizes.get(match.group(1), 0) + int(match.group(2), 16)
+    return sizes
+
+
+def frames(asmfile):
+    """Local frame of every function, the return address (or the interrupt
+    context) included. Returns [(name, bytes)]"""
+    result = []
+    name, local, isr = None, 0, False
+
+    def close():
+        if name:
+            result.append((name, local + (9 if isr else 2)))
+
+    with open(asmfile) as f:
+        for line in f:
+            match = FUNCTION_RE.match(line)
+            if match:
+                close()
+                name, local, isr = match.group(1), 0, False
+                continue
+            match = FRAME_RE.match(line)
+            if match and name and not local:
+                local = int(match.group(1), 0)
+            if name and ISR_RE.match(line):
+                isr = True
+    close()
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description="RAM, flash and stack frame budget per module")
+    parser.add_argument("--ram", type=int, default=1024)
+    parser.add_argument("--flash", type=int, default=8192)
+    parser.add_argument("objdir")
+    args = parser.parse_args()
+
+    symfiles = sorted(glob.glob(os.path.join(args.objdir, "*.sym")))
+    if not symfiles:
+        sys.exit("no .sym files in %s, build first" % args.objdir)
+
+    print("%-12s %6s %6s %6s  %s" % ("module", "flash", "ram", "frame", "deepest function"))
+    totalFlash, totalRam, deepest = 0, 0, []
+    for symfile in symfiles:
+        module = os.path.splitext(os.path.basename(symfile))[0]
+        sizes = areas(symfile)
+        flash = sum(sizes.get(a, 0) for a in FLASH_AREAS)
+        ram = sum(sizes.get(a, 0) for a in RAM_AREAS)
+        asmfile = os.path.splitext(symfile)[0] + ".asm"
+        funcs = frames(asmfile) if os.path.exists(asmfile) else []
+        top = max(funcs, key=lambda f: f[1]) if funcs else ("-", 0)
+        deepest += funcs
+        totalFlash += flash
+        totalRam += ram
+        print("%-12s %6d %6d %6d  %s" % (module, flash, ram, top[1], top[0]))
+
+    print("%-12s %6d %6d" % ("total", totalFlash, totalRam))
+    print()
+    print("flash %d of %d bytes, %d free" % (totalFlash, args.flash, args.flash - totalFlash))
+    print("static RAM %d of %d bytes, %d left for the stack" % (totalRam, args.ram, args.ram - totalRam))
+    print()
+    print("largest frames (locals + return address, calls nest on top of each other):")
+    for name, size in sorted(deepest, key=lambda f: -f[1])[:8]:
+        print("  %-32s %4d" % (name, size))
+    print("the runtime high-water mark comes with the PROFILING=1 frames")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,109 @@
+//
+//  uart.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <stm8s.h>
+#include <uart.h>
+
+#ifndef F_CPU
+#warning "F_CPU not defined, using 16MHz by default"
+#define F_CPU 16000000UL
+#endif
+
+#define TX_MASK (UART_TX_BUFFER - 1)
+
+static uint8_t _txBuffer[UART_TX_BUFFER];
+static volatile uint8_t _txHead = 0; // written by UART_write only
+static volatile uint8_t _txTail = 0; // written by the ISR only
+
+#define RX_MASK (UART_RX_BUFFER - 1)
+
+static uint8_t _rxBuffer[UART_RX_BUFFER];
+static volatile uint8_t _rxHead = 0; // written by the ISR only
+static volatile uint8_t _rxTail = 0; // written by UART_read only
+
+void UART1_TX_interrupt_handler() __interrupt(UART1_TXC_ISR)
+{
+    if (_txTail != _txHead)
+    {
+        UART1_DR = _txBuffer[_txTail];
+        _txTail = (_txTail + 1) & TX_MASK;
+    }
+    else
+    {
+        // Nothing more to send, stop the TX empty interrupt
+        UART1_CR2 &= ~(1 << UART1_CR2_TIEN);
+    }
+}
+
+void UART1_RX_interrupt_handler() __interrupt(UART1_RXC_ISR)
+{
+    // Reading SR then DR clears RXNE and the error flags, with an error
+    // flag left set the interrupt would come back for ever
+    uint8_t status = UART1_SR;
+    uint8_t byte = UART1_DR;
+    if (status & ((1 << UART1_SR_OR) | (1 << UART1_SR_NF) | (1 << UART1_SR_FE)))
+        return; // dropped, the frame checksum catches it
+    uint8_t head = (_rxHead + 1) & RX_MASK;
+    if (head != _rxTail)
+    {
+        _rxBuffer[_rxHead] = byte;
+        _rxHead = head;
+    }
+}
+
+void UART_init(uint32_t baud)
+{
+    uint16_t div = (F_CPU + baud / 2) / baud;
+    UART1_CR1 = 0; // 8 data bits, no parity
+    UART1_CR3 = 0; // 1 stop bit
+    // BRR2 has to be written first
+    UART1_BRR2 = ((div >> 8) & 0xF0) | (div & 0x0F);
+    UART1_BRR1 = (div >> 4) & 0xFF;
+    UART1_CR2 = (1 << UART1_CR2_TEN) | (1 << UART1_CR2_REN) | (1 << UART1_CR2_RIEN);
+}
+
+uint8_t UART_write(const void *data, uint8_t len)
+{
+    const uint8_t *p = data;
+    uint8_t head = _txHead;
+    if (len > ((_txTail - head - 1) & TX_MASK))
+        return 0;
+    while (len--)
+    {
+        _txBuffer[head] = *p++;
+        head = (head + 1) & TX_MASK;
+    }
+    _txHead = head;
+    UART1_CR2 |= (1 << UART1_CR2_TIEN);
+    return 1;
+}
+
+uint8_t UART_read(uint8_t *byte)
+{
+    uint8_t tail = _rxTail;
+    if (tail == _rxHead)
+        return 0;
+    *byte = _rxBuffer[tail];
+    _rxTail = (tail + 1) & RX_MASK;
+    return 1;
+}
@@ -0,0 +1,60 @@
+//
+//  uart.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef _UART_H_
+#define _UART_H_
+
+#include <stm8s.h>
+
+// Transmit ring buffer, must be a power of 2
+#ifndef UART_TX_BUFFER
+#define UART_TX_BUFFER 64
+#endif
+
+// Receive ring buffer, must be a power of 2
+#ifndef UART_RX_BUFFER
+#define UART_RX_BUFFER 64
+#endif
+
+void UART1_TX_interrupt_handler() __interrupt(UART1_TXC_ISR);
+void UART1_RX_interrupt_handler() __interrupt(UART1_RXC_ISR);
+
+/*
+ *  Configure UART1 for 8N1, transmit on PD5 and receive on PD6
+ *  in: baud rate
+ */
+void UART_init(uint32_t baud);
+
+/*
+ *  Queue the bytes for transmission, never waits
+ *  out: non-zero when queued, 0 when the buffer has no room for all of them
+ */
+uint8_t UART_write(const void *data, uint8_t len);
+
+/*
+ *  Take the oldest received byte, bytes arriving while the buffer is full are lost
+ *  out: non-zero when a byte was read
+ */
+uint8_t UART_read(uint8_t *byte);
+
+#endif //_UART_H_
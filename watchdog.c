@@ -0,0 +1,72 @@
+//
+//  watchdog.c
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <stm8s.h>
+#include <eeprom.h>
+#include <watchdog.h>
+
+#define RESET_ABNORMAL (RESET_WWDG | RESET_IWDG | RESET_ILLOP | RESET_EMC)
+
+static uint8_t increment(uint8_t count)
+{
+    return count < 0xFF ? count + 1 : count;
+}
+
+static void recordReset(uint8_t cause)
+{
+    struct RESET_LOG log;
+    WATCHDOG_resetLog(&log);
+    log.lastCause = cause;
+    if (cause & (RESET_IWDG | RESET_WWDG))
+        log.watchdog = increment(log.watchdog);
+    if (cause & RESET_ILLOP)
+        log.illegalOp = increment(log.illegalOp);
+    if (cause & RESET_EMC)
+        log.emc = increment(log.emc);
+    eeprom_write(RESET_LOG_ADDR, &log, sizeof(log));
+}
+
+void WATCHDOG_init()
+{
+    // The flags survive the reset, they are cleared by writing 1
+    uint8_t cause = RST_SR;
+    RST_SR = cause;
+    if (cause & RESET_ABNORMAL)
+        recordReset(cause);
+
+    IWDG_KR = IWDG_KEY_ENABLE;
+    IWDG_KR = IWDG_KEY_ACCESS;
+    IWDG_PR = WATCHDOG_PRESCALER;
+    IWDG_RLR = WATCHDOG_RELOAD;
+    IWDG_KR = IWDG_KEY_REFRESH;
+}
+
+void WATCHDOG_refresh()
+{
+    IWDG_KR = IWDG_KEY_REFRESH;
+}
+
+void WATCHDOG_resetLog(struct RESET_LOG *log)
+{
+    eeprom_read(RESET_LOG_ADDR, log, sizeof(*log));
+}
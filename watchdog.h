@@ -0,0 +1,69 @@
+//
+//  watchdog.h
+//  cxg-60ewt
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef _WATCHDOG_H_
+#define _WATCHDOG_H_
+
+#include <stdint.h>
+#include <eeprom.h>
+
+// IWDG timeout 2 * 2^(PR + 2) * (RLR + 1) / fLSI = 2 * 256 * 256 / 128 kHz,
+// about 1 s, the longest: the heater stays uncontrolled at most that long
+#define WATCHDOG_PRESCALER 6
+#define WATCHDOG_RELOAD 0xFF
+
+// Reset causes, the RST_SR flags
+#define RESET_WWDG 0x01
+#define RESET_IWDG 0x02
+#define RESET_ILLOP 0x04
+#define RESET_SWIM 0x08
+#define RESET_EMC 0x10
+
+// Post-mortem record, kept in the EEPROM after the settings log
+#define RESET_LOG_ADDR (EEPROM_END_ADDR + 1)
+
+struct RESET_LOG
+{
+    uint8_t lastCause;  // RST_SR flags of the last abnormal reset
+    uint8_t watchdog;   // IWDG and WWDG resets, saturating counters
+    uint8_t illegalOp;  // illegal opcode resets
+    uint8_t emc;        // EMC resets
+};
+
+/*
+ *  Record the reset cause and start the independent watchdog,
+ *  it can't be stopped once started
+ */
+void WATCHDOG_init();
+
+/*
+ *  Reload the watchdog counter
+ */
+void WATCHDOG_refresh();
+
+/*
+ *  The post-mortem record
+ */
+void WATCHDOG_resetLog(struct RESET_LOG *log);
+
+#endif //_WATCHDOG_H_